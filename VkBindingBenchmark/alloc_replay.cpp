@@ -0,0 +1,333 @@
+#include "alloc_replay.h"
+#include "vkh_memory_backend.h"
+#include "os_init.h"
+#include <stdio.h>
+#include <math.h>
+#include <map>
+#include <random>
+#include <algorithm>
+
+#define ALLOC_TRACE_PATH "..\\data\\_generated\\alloc_trace.bin"
+
+//roughly a scene's worth of buffers and textures kept alive while the churn runs
+#define CHURN_LIVE_ALLOCATIONS 2000
+#define CHURN_STEPS 20000
+#define CHURN_MIN_SIZE (1024.0)
+#define CHURN_MAX_SIZE (4.0 * 1024.0 * 1024.0)
+
+namespace alloc_replay
+{
+	enum ETraceOpType : uint32_t
+	{
+		OP_ALLOC,
+		OP_FREE
+	};
+
+	//ids are handed out in allocation order from 0, a free refers to the alloc with the same id
+	struct TraceOp
+	{
+		uint32_t type;
+		uint32_t id;
+		uint32_t memoryType;
+		uint32_t usage;
+		uint64_t size;
+		uint64_t alignment;
+	};
+
+	struct TraceHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t numOps;
+		uint32_t numAllocs;
+	};
+
+	const uint32_t TRACE_MAGIC = 0x43415254; //"TRAC"
+	const uint32_t TRACE_VERSION = 1;
+
+	struct RecordingState
+	{
+		vkh::AllocatorInterface recordedAllocator;
+		std::vector<TraceOp> ops;
+		std::map<std::pair<VkDeviceMemory, VkDeviceSize>, uint32_t> liveIds;
+		uint32_t numAllocs;
+	};
+
+	RecordingState recording;
+
+	void recordActivate(vkh::VkhContext* context);
+	void recordAlloc(vkh::Allocation& outAlloc, vkh::AllocationCreateInfo createInfo);
+	void recordFree(vkh::Allocation& allocation);
+	size_t recordAllocatedSize(uint32_t memoryType);
+	uint32_t recordNumAllocs();
+	void recordGetStats(uint32_t memoryType, vkh::MemoryTypeStats& outStats);
+	const char* recordGetName();
+
+	vkh::AllocatorInterface recordingImpl = { recordActivate, recordAlloc, recordFree, recordAllocatedSize, recordNumAllocs, recordGetStats, recordGetName };
+
+	void recordActivate(vkh::VkhContext* context)
+	{
+		recording.recordedAllocator.activate(context);
+		context->allocator = recordingImpl;
+	}
+
+	void recordAlloc(vkh::Allocation& outAlloc, vkh::AllocationCreateInfo createInfo)
+	{
+		recording.recordedAllocator.alloc(outAlloc, createInfo);
+
+		uint32_t id = recording.numAllocs++;
+		recording.liveIds[{ outAlloc.handle, outAlloc.offset }] = id;
+		recording.ops.push_back({ OP_ALLOC, id, createInfo.memoryTypeIndex, createInfo.usage, createInfo.size, createInfo.alignment });
+	}
+
+	void recordFree(vkh::Allocation& allocation)
+	{
+		auto found = recording.liveIds.find({ allocation.handle, allocation.offset });
+		checkf(found != recording.liveIds.end(), "Freeing an allocation the trace never saw");
+
+		recording.ops.push_back({ OP_FREE, found->second, allocation.type, 0, allocation.size, 0 });
+		recording.liveIds.erase(found);
+
+		recording.recordedAllocator.free(allocation);
+	}
+
+	size_t recordAllocatedSize(uint32_t memoryType)
+	{
+		return recording.recordedAllocator.allocatedSize(memoryType);
+	}
+
+	uint32_t recordNumAllocs()
+	{
+		return recording.recordedAllocator.numAllocs();
+	}
+
+	void recordGetStats(uint32_t memoryType, vkh::MemoryTypeStats& outStats)
+	{
+		recording.recordedAllocator.getStats(memoryType, outStats);
+	}
+
+	//recording doesn't change how anything is allocated, so it reports the recorded allocator's name
+	const char* recordGetName()
+	{
+		return recording.recordedAllocator.getName();
+	}
+
+	void startRecording(vkh::VkhContext& ctxt)
+	{
+		recording.recordedAllocator = ctxt.allocator;
+		recording.ops.clear();
+		recording.liveIds.clear();
+		recording.numAllocs = 0;
+
+		ctxt.allocator = recordingImpl;
+	}
+
+	void saveRecording()
+	{
+		FILE* outFile = nullptr;
+		fopen_s(&outFile, ALLOC_TRACE_PATH, "wb");
+		if (!outFile)
+		{
+			printf("Alloc trace: couldn't open %s for writing, trace not saved\n", ALLOC_TRACE_PATH);
+			return;
+		}
+
+		TraceHeader header = { TRACE_MAGIC, TRACE_VERSION, static_cast<uint32_t>(recording.ops.size()), recording.numAllocs };
+		fwrite(&header, sizeof(TraceHeader), 1, outFile);
+		fwrite(recording.ops.data(), sizeof(TraceOp), recording.ops.size(), outFile);
+		fclose(outFile);
+
+		printf("Alloc trace: saved %u ops (%u allocations)\n", header.numOps, header.numAllocs);
+	}
+
+	//returns the number of allocations in the trace, 0 if there's no usable trace on disk
+	uint32_t loadRecording(std::vector<TraceOp>& outOps, const VkPhysicalDeviceMemoryProperties& memProperties)
+	{
+		FILE* inFile = nullptr;
+		fopen_s(&inFile, ALLOC_TRACE_PATH, "rb");
+		if (!inFile) return 0;
+
+		TraceHeader header = {};
+		bool valid = fread(&header, sizeof(TraceHeader), 1, inFile) == 1;
+		valid &= header.magic == TRACE_MAGIC && header.version == TRACE_VERSION;
+
+		if (valid)
+		{
+			outOps.resize(header.numOps);
+			valid = fread(outOps.data(), sizeof(TraceOp), header.numOps, inFile) == header.numOps;
+		}
+		fclose(inFile);
+
+		//memory type indices are only meaningful on the gpu the trace was recorded on
+		for (uint32_t i = 0; valid && i < outOps.size(); ++i)
+		{
+			valid = outOps[i].memoryType < memProperties.memoryTypeCount && outOps[i].id < header.numAllocs;
+		}
+
+		if (!valid)
+		{
+			printf("Alloc trace: %s is invalid or from another gpu, skipping\n", ALLOC_TRACE_PATH);
+			outOps.clear();
+			return 0;
+		}
+
+		return header.numAllocs;
+	}
+
+	//every device local allocation is preceded by a staging allocation of the same size that's freed right after,
+	//like an upload would. After the initial load, random allocations are freed and replaced for CHURN_STEPS steps
+	uint32_t buildChurnTrace(std::vector<TraceOp>& outOps, vkh::VkhContext& ctxt)
+	{
+		const VkMemoryPropertyFlags deviceUsage = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		const VkMemoryPropertyFlags stagingUsage = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		const uint32_t deviceType = vkh::getMemoryType(ctxt.gpu.device, 0xFFFFFFFF, deviceUsage);
+		const uint32_t stagingType = vkh::getMemoryType(ctxt.gpu.device, 0xFFFFFFFF, stagingUsage);
+
+		std::mt19937 rng(8675309);
+		std::uniform_real_distribution<double> logSize(log(CHURN_MIN_SIZE), log(CHURN_MAX_SIZE));
+
+		uint32_t nextId = 0;
+		std::vector<TraceOp> live;
+
+		auto upload = [&]()
+		{
+			//sizes are log uniform so small buffers vastly outnumber big textures, images get 64KB alignment
+			uint64_t size = (static_cast<uint64_t>(exp(logSize(rng))) + 255) & ~255ull;
+			uint64_t alignment = rng() % 4 == 0 ? 65536 : 256;
+
+			TraceOp staging = { OP_ALLOC, nextId++, stagingType, stagingUsage, size, 256 };
+			TraceOp resource = { OP_ALLOC, nextId++, deviceType, deviceUsage, size, alignment };
+
+			outOps.push_back(staging);
+			outOps.push_back(resource);
+			staging.type = OP_FREE;
+			outOps.push_back(staging);
+
+			live.push_back(resource);
+		};
+
+		for (uint32_t i = 0; i < CHURN_LIVE_ALLOCATIONS; ++i)
+		{
+			upload();
+		}
+
+		for (uint32_t i = 0; i < CHURN_STEPS; ++i)
+		{
+			uint32_t victim = rng() % live.size();
+			TraceOp freeOp = live[victim];
+			freeOp.type = OP_FREE;
+			outOps.push_back(freeOp);
+
+			live[victim] = live.back();
+			live.pop_back();
+
+			upload();
+		}
+
+		return nextId;
+	}
+
+	void printPercentiles(const char* label, std::vector<double>& timesMs)
+	{
+		if (timesMs.size() == 0)
+		{
+			printf("  %s: none\n", label);
+			return;
+		}
+
+		std::sort(timesMs.begin(), timesMs.end());
+		size_t p99 = std::min(timesMs.size() - 1, timesMs.size() * 99 / 100);
+
+		printf("  %s (us): p50 %.3f, p99 %.3f, max %.3f\n", label, timesMs[timesMs.size() / 2] * 1000.0, timesMs[p99] * 1000.0, timesMs.back() * 1000.0);
+	}
+
+	void replay(const std::vector<TraceOp>& ops, uint32_t numAllocs, const vkh::AllocatorInterface& allocator, const char* name, vkh::VkhContext& ctxt)
+	{
+		vkh::memory_backend::resetMockStats();
+		allocator.activate(&ctxt);
+
+		std::vector<vkh::Allocation> allocations(numAllocs);
+		std::vector<double> allocTimes;
+		std::vector<double> freeTimes;
+		allocTimes.reserve(numAllocs);
+		freeTimes.reserve(numAllocs);
+
+		VkDeviceSize liveBytes = 0;
+
+		for (const TraceOp& op : ops)
+		{
+			vkh::Allocation& allocation = allocations[op.id];
+
+			if (op.type == OP_ALLOC)
+			{
+				vkh::AllocationCreateInfo createInfo = { op.usage, op.memoryType, op.size, op.alignment };
+
+				double start = OS::getMilliseconds();
+				ctxt.allocator.alloc(allocation, createInfo);
+				allocTimes.push_back(OS::getMilliseconds() - start);
+
+				liveBytes += op.size;
+			}
+			else
+			{
+				double start = OS::getMilliseconds();
+				ctxt.allocator.free(allocation);
+				freeTimes.push_back(OS::getMilliseconds() - start);
+
+				liveBytes -= op.size;
+			}
+		}
+
+		//fragmentation is the share of committed memory that isn't backing a live allocation at the end of the trace
+		const vkh::memory_backend::MockStats& stats = vkh::memory_backend::getMockStats();
+		double fragmentation = stats.committed > 0 ? 1.0 - liveBytes / (double)stats.committed : 0.0;
+
+		printf(" %s:\n", name);
+		printPercentiles("alloc", allocTimes);
+		printPercentiles("free", freeTimes);
+		printf("  peak committed %.2f MB, fragmentation %.1f%%, blocks %u (peak %u, %u created)\n",
+			stats.peakCommitted / (1024.0 * 1024.0), fragmentation * 100.0, stats.liveAllocations, stats.peakAllocations, stats.totalAllocations);
+	}
+
+	void runBenchmark(const vkh::AllocatorInterface* allocators, const char** names, uint32_t count, vkh::VkhContext& ctxt)
+	{
+		checkf(ctxt.allocator.numAllocs() == 0, "The allocator benchmark has to run before anything is allocated");
+
+		const vkh::AllocatorInterface active = ctxt.allocator;
+
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(ctxt.gpu.device, &memProperties);
+
+		std::vector<TraceOp> recordedOps;
+		uint32_t recordedAllocs = loadRecording(recordedOps, memProperties);
+
+		std::vector<TraceOp> churnOps;
+		uint32_t churnAllocs = buildChurnTrace(churnOps, ctxt);
+
+		vkh::memory_backend::setMock(true);
+
+		if (recordedAllocs > 0)
+		{
+			printf("Allocator benchmark, recorded trace (%u ops)\n", static_cast<uint32_t>(recordedOps.size()));
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				replay(recordedOps, recordedAllocs, allocators[i], names[i], ctxt);
+			}
+		}
+		else
+		{
+			printf("Allocator benchmark: no recorded trace, set RECORD_ALLOC_TRACE to make one\n");
+		}
+
+		printf("Allocator benchmark, synthetic churn (%u ops)\n", static_cast<uint32_t>(churnOps.size()));
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			replay(churnOps, churnAllocs, allocators[i], names[i], ctxt);
+		}
+
+		vkh::memory_backend::resetMockStats();
+		vkh::memory_backend::setMock(false);
+
+		active.activate(&ctxt);
+	}
+}
\ No newline at end of file
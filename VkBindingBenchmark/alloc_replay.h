@@ -0,0 +1,17 @@
+#pragma once
+#include "vkh.h"
+
+//Records the allocations the app makes through ctxt.allocator to a trace file, and replays traces against allocators
+//on top of the mock memory backend so they can be compared without touching the GPU's memory at all
+namespace alloc_replay
+{
+	//wraps ctxt.allocator, every alloc and free from here on is recorded until saveRecording
+	void startRecording(vkh::VkhContext& ctxt);
+	void saveRecording();
+
+	//replays the recorded trace (if there is one) and a synthetic churn trace against each allocator, printing
+	//latency percentiles, peak committed memory, fragmentation and block count for each. Allocators' state
+	//is reset by activating them, so this has to run before anything is allocated. ctxt's allocator is
+	//activated again afterwards
+	void runBenchmark(const vkh::AllocatorInterface* allocators, const char** names, uint32_t count, vkh::VkhContext& ctxt);
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "command_recorder.h"
+#include <mutex>
+#include <stdio.h>
+
+#define STATE_STATS_FRAMES 1024
+
+#if FILTER_REDUNDANT_STATE
+namespace command_recorder
+{
+	static const char* commandNames[CMD_TYPE_COUNT] = { "pipeline", "descriptor set", "vertex buffer", "index buffer", "push constants" };
+
+	std::mutex statsLock;
+	uint64_t totalIssued[CMD_TYPE_COUNT];
+	uint64_t totalEliminated[CMD_TYPE_COUNT];
+	uint64_t totalDraws;
+	uint32_t frames;
+
+	void end(Recorder& rec)
+	{
+		std::lock_guard<std::mutex> lock(statsLock);
+		for (uint32_t i = 0; i < CMD_TYPE_COUNT; ++i)
+		{
+			totalIssued[i] += rec.issued[i];
+			totalEliminated[i] += rec.eliminated[i];
+		}
+	}
+
+	void logStats(uint32_t numDraws)
+	{
+		std::lock_guard<std::mutex> lock(statsLock);
+
+		totalDraws += numDraws;
+		if (++frames < STATE_STATS_FRAMES) return;
+
+		uint64_t issued = 0;
+		uint64_t eliminated = 0;
+
+		printf("STATE FILTERING (avg per frame over past %i frames, %.0f draws):\n", STATE_STATS_FRAMES, totalDraws / (double)frames);
+		for (uint32_t i = 0; i < CMD_TYPE_COUNT; ++i)
+		{
+			printf("\t%-16s issued %10.1f eliminated %10.1f\n", commandNames[i], totalIssued[i] / (double)frames, totalEliminated[i] / (double)frames);
+			issued += totalIssued[i];
+			eliminated += totalEliminated[i];
+
+			totalIssued[i] = 0;
+			totalEliminated[i] = 0;
+		}
+
+		uint64_t total = issued + eliminated;
+		printf("\ttotal eliminated: %.1f%%\n", total > 0 ? 100.0 * eliminated / total : 0.0);
+
+		totalDraws = 0;
+		frames = 0;
+	}
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "vkh.h"
+#include "config.h"
+
+//Thin wrapper over the vkCmd* calls made per draw. With FILTER_REDUNDANT_STATE it remembers what is bound
+//to its command buffer and drops calls that wouldn't change anything, counting issued and dropped calls.
+//Without it every call goes straight through. One Recorder per command buffer being recorded, so parallel
+//recording threads never share one
+namespace command_recorder
+{
+	enum CommandType
+	{
+		CMD_BIND_PIPELINE,
+		CMD_BIND_DESCRIPTOR_SET,
+		CMD_BIND_VERTEX_BUFFER,
+		CMD_BIND_INDEX_BUFFER,
+		CMD_PUSH_CONSTANTS,
+		CMD_TYPE_COUNT
+	};
+
+	static const uint32_t MAX_PUSH_CONSTANT_BYTES = 128;
+
+	struct Recorder
+	{
+		VkCommandBuffer		cmd;
+
+#if FILTER_REDUNDANT_STATE
+		VkPipeline			pipeline;
+		VkPipelineLayout	setLayout;
+		VkDescriptorSet		descSet;
+		uint32_t			dynamicOffsetCount;
+		uint32_t			dynamicOffset;
+
+		VkBuffer			vertexBuffer;
+		VkDeviceSize		vertexOffset;
+
+		VkBuffer			indexBuffer;
+		VkDeviceSize		indexOffset;
+		VkIndexType			indexType;
+
+		//only ranges starting at offset 0 are tracked, which is all this app pushes
+		VkPipelineLayout	pushLayout;
+		uint32_t			pushSize;
+		uint8_t				pushData[MAX_PUSH_CONSTANT_BYTES];
+
+		uint32_t			issued[CMD_TYPE_COUNT];
+		uint32_t			eliminated[CMD_TYPE_COUNT];
+#endif
+	};
+
+	//a command buffer starts with nothing bound, so the cache starts empty too
+	inline void begin(Recorder& rec, VkCommandBuffer cmd)
+	{
+#if FILTER_REDUNDANT_STATE
+		memset(&rec, 0, sizeof(Recorder));
+#endif
+		rec.cmd = cmd;
+	}
+
+#if FILTER_REDUNDANT_STATE
+	//adds the recorder's counts to the totals logged by logStats, safe to call from recording threads
+	void end(Recorder& rec);
+
+	//prints issued / eliminated calls per draw every STATE_STATS_FRAMES calls, call once per frame
+	void logStats(uint32_t numDraws);
+#else
+	inline void end(Recorder& rec) {}
+	inline void logStats(uint32_t numDraws) {}
+#endif
+
+	inline void bindPipeline(Recorder& rec, VkPipeline pipeline)
+	{
+#if FILTER_REDUNDANT_STATE
+		if (rec.pipeline == pipeline)
+		{
+			rec.eliminated[CMD_BIND_PIPELINE]++;
+			return;
+		}
+		rec.pipeline = pipeline;
+		rec.issued[CMD_BIND_PIPELINE]++;
+#endif
+		vkCmdBindPipeline(rec.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	}
+
+	//binds to set 0, which is the only set any material in this app uses. dynamicOffsetCount is 0 or 1
+	inline void bindDescriptorSet(Recorder& rec, VkPipelineLayout layout, VkDescriptorSet set, uint32_t dynamicOffsetCount, uint32_t dynamicOffset)
+	{
+#if FILTER_REDUNDANT_STATE
+		if (rec.setLayout == layout && rec.descSet == set && rec.dynamicOffsetCount == dynamicOffsetCount && rec.dynamicOffset == dynamicOffset)
+		{
+			rec.eliminated[CMD_BIND_DESCRIPTOR_SET]++;
+			return;
+		}
+		rec.setLayout = layout;
+		rec.descSet = set;
+		rec.dynamicOffsetCount = dynamicOffsetCount;
+		rec.dynamicOffset = dynamicOffset;
+		rec.issued[CMD_BIND_DESCRIPTOR_SET]++;
+#endif
+		vkCmdBindDescriptorSets(rec.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &set, dynamicOffsetCount, &dynamicOffset);
+	}
+
+	inline void bindVertexBuffer(Recorder& rec, VkBuffer buffer, VkDeviceSize offset)
+	{
+#if FILTER_REDUNDANT_STATE
+		if (rec.vertexBuffer == buffer && rec.vertexOffset == offset)
+		{
+			rec.eliminated[CMD_BIND_VERTEX_BUFFER]++;
+			return;
+		}
+		rec.vertexBuffer = buffer;
+		rec.vertexOffset = offset;
+		rec.issued[CMD_BIND_VERTEX_BUFFER]++;
+#endif
+		vkCmdBindVertexBuffers(rec.cmd, 0, 1, &buffer, &offset);
+	}
+
+	inline void bindIndexBuffer(Recorder& rec, VkBuffer buffer, VkDeviceSize offset, VkIndexType type)
+	{
+#if FILTER_REDUNDANT_STATE
+		if (rec.indexBuffer == buffer && rec.indexOffset == offset && rec.indexType == type)
+		{
+			rec.eliminated[CMD_BIND_INDEX_BUFFER]++;
+			return;
+		}
+		rec.indexBuffer = buffer;
+		rec.indexOffset = offset;
+		rec.indexType = type;
+		rec.issued[CMD_BIND_INDEX_BUFFER]++;
+#endif
+		vkCmdBindIndexBuffer(rec.cmd, buffer, offset, type);
+	}
+
+	//pushes size bytes at offset 0
+	inline void pushConstants(Recorder& rec, VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t size, const void* data)
+	{
+#if FILTER_REDUNDANT_STATE
+		checkf(size <= MAX_PUSH_CONSTANT_BYTES, "Push constant range is larger than the recorder tracks");
+
+		if (rec.pushLayout == layout && rec.pushSize == size && memcmp(rec.pushData, data, size) == 0)
+		{
+			rec.eliminated[CMD_PUSH_CONSTANTS]++;
+			return;
+		}
+		rec.pushLayout = layout;
+		rec.pushSize = size;
+		memcpy(rec.pushData, data, size);
+		rec.issued[CMD_PUSH_CONSTANTS]++;
+#endif
+		vkCmdPushConstants(rec.cmd, layout, stages, 0, size, data);
+	}
+}
\ No newline at end of file
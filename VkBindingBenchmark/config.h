@@ -18,14 +18,61 @@
 #define WITH_VK_TIMESTAMP 0
 #define PERSISTENT_STAGING_BUFFER 1
 #define COPY_ON_MAIN_COMMANDBUFFER 1
+#define ASYNC_TRANSFER_QUEUE 0
 #define COMBINE_MESHES 0
 #define SHUFFLE_MESHES 1
+#define COMPUTE_TRANSFORMS 0
+#define DIRECT_TO_VRAM 0
+#define STREAMING_STORES 0
+#define FILL_BANDWIDTH_BENCHMARK 0
+#define SCENE_GRAPH 0
+#define ANIMATED_OBJECT_FRACTION 0.1f
+#define PARALLEL_RECORDING 0
+#define RECORDING_THREADS 4
+#define STATIC_COMMAND_BUFFERS 0
+#define CPU_FRUSTUM_CULLING 0
+#define GPU_CULLING 0
+#define SORT_DRAWS 0
+#define FILTER_REDUNDANT_STATE 0
+#define FRAMES_IN_FLIGHT 2
+#define MESH_ARENA 0
+#define COMPACT_INDICES 0
+#define QUANTIZED_VERTICES 0
+#define OCT_NORMAL_BITS 16
+#define MESHLETS 0
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define PIPELINE_CACHE 1
+#define PIPELINE_PERMUTATIONS 0
+#define PIPELINE_THREADS 4
+#define TLSF_ALLOCATOR 0
+#define ALLOCATOR_BENCHMARK 0
+#define RECORD_ALLOC_TRACE 0
+#define FRAME_UPLOAD_RING 1
+#define FRAME_RING_SIZE (16 << 20)
+#define FRAME_HOST_ARENA_SIZE (1 << 20)
+#define MEMORY_STATS_INTERVAL 0
+#define DEFRAGMENT 0
+#define DEFRAG_BUDGET_MS 0.5
+#define DEFRAG_MAX_BYTES_PER_STEP (8 << 20)
+#define DEFRAG_MAX_OCCUPANCY 0.5
+#define THREAD_SAFE_ALLOCATOR 0
+#define THREAD_CACHE_CHUNK_SIZE (4 << 20)
+#define THREAD_CACHE_MAX_ALLOC_SIZE (256 << 10)
+#define THREAD_CACHE_MAX_CHUNKS 4096
+#define ALLOCATOR_CONTENTION_BENCHMARK 0
 
 #define WITH_COMPLEX_SHADER 1
 
 #if UBO_TEST
 	#define data_store ubo_store
-	#if DYNAMIC_UBO	
+	#if GPU_CULLING
+		#define VERT_SHADER_NAME "..\\data\\_generated\\builtshaders\\ubo_array_indirect.vert.spv"
+	#elif QUANTIZED_VERTICES && DYNAMIC_UBO
+		#define VERT_SHADER_NAME "..\\data\\_generated\\builtshaders\\dynamic_ubo_quantized.vert.spv"
+	#elif QUANTIZED_VERTICES
+		#define VERT_SHADER_NAME "..\\data\\_generated\\builtshaders\\ubo_array_quantized.vert.spv"
+	#elif DYNAMIC_UBO	
 		#define VERT_SHADER_NAME "..\\data\\_generated\\builtshaders\\dynamic_ubo.vert.spv"
 	#else
 		#define VERT_SHADER_NAME "..\\data\\_generated\\builtshaders\\ubo_array.vert.spv"
@@ -33,7 +80,11 @@
 	#include "ubo_store.h"
 #elif SSBO_TEST
 	#define data_store ssbo_store
-	#if BISTRO_TEST
+	#if GPU_CULLING
+		#define VERT_SHADER_NAME "..\\data\\_generated\\builtshaders\\ssbo_array_indirect.vert.spv"
+	#elif QUANTIZED_VERTICES
+		#define VERT_SHADER_NAME "..\\data\\_generated\\builtshaders\\ssbo_array_quantized.vert.spv"
+	#elif BISTRO_TEST
 		#define VERT_SHADER_NAME "..\\data\\_generated\\builtshaders\\ssbo_array.vert.spv"
 	#else
 		#define VERT_SHADER_NAME "..\\data\\_generated\\builtshaders\\ssbo_array_511.vert.spv"
@@ -52,6 +103,29 @@ static_assert(  PERSISTENT_STAGING_BUFFER == 0	|| PERSISTENT_STAGING_BUFFER == D
 static_assert(  COPY_ON_MAIN_COMMANDBUFFER == 0 || COPY_ON_MAIN_COMMANDBUFFER == DEVICE_LOCAL, "COPY_ON_MAIN_COMMANDBUFFER requires DEVICE_LOCAL to function");
 static_assert(COPY_ON_MAIN_COMMANDBUFFER + PERSISTENT_STAGING_BUFFER == 0 || !COPY_ON_MAIN_COMMANDBUFFER || COPY_ON_MAIN_COMMANDBUFFER + PERSISTENT_STAGING_BUFFER == 2, "Must have UBO_TEST defined to use DYNAMIC_UBO");
 static_assert(UBO_TEST + DYNAMIC_UBO == 0 || !DYNAMIC_UBO || UBO_TEST + DYNAMIC_UBO == 2, "Must have UBO_TEST defined to use DYNAMIC_UBO");
+static_assert(ASYNC_TRANSFER_QUEUE == 0 || (!COPY_ON_MAIN_COMMANDBUFFER && PERSISTENT_STAGING_BUFFER), "ASYNC_TRANSFER_QUEUE requires PERSISTENT_STAGING_BUFFER and replaces COPY_ON_MAIN_COMMANDBUFFER");
+static_assert(COMPUTE_TRANSFORMS == 0 || ((UBO_TEST || SSBO_TEST) && COPY_ON_MAIN_COMMANDBUFFER), "COMPUTE_TRANSFORMS requires UBO_TEST or SSBO_TEST, and COPY_ON_MAIN_COMMANDBUFFER to dispatch before the render pass");
+static_assert(DIRECT_TO_VRAM == 0 || !COMPUTE_TRANSFORMS, "DIRECT_TO_VRAM and COMPUTE_TRANSFORMS are separate upload strategies, pick one");
+static_assert(STREAMING_STORES == 0 || !DEVICE_LOCAL || PERSISTENT_STAGING_BUFFER, "STREAMING_STORES writes to mapped memory, DEVICE_LOCAL without PERSISTENT_STAGING_BUFFER fills a malloc'd buffer");
+static_assert(SCENE_GRAPH == 0 || UBO_TEST || SSBO_TEST, "SCENE_GRAPH feeds per object transforms to the data store, requires UBO_TEST or SSBO_TEST");
+static_assert(ANIMATED_OBJECT_FRACTION >= 0.0f && ANIMATED_OBJECT_FRACTION <= 1.0f, "ANIMATED_OBJECT_FRACTION must be between 0 and 1");
+static_assert(RECORDING_THREADS >= 1, "RECORDING_THREADS includes the main thread, must be at least 1");
+static_assert(STATIC_COMMAND_BUFFERS == 0 || ((UBO_TEST || SSBO_TEST) && !PARALLEL_RECORDING), "STATIC_COMMAND_BUFFERS requires camera independent draws (UBO_TEST or SSBO_TEST) and replaces PARALLEL_RECORDING");
+static_assert(CPU_FRUSTUM_CULLING == 0 || !STATIC_COMMAND_BUFFERS, "CPU_FRUSTUM_CULLING changes the draw list every frame, it can't be used with STATIC_COMMAND_BUFFERS");
+static_assert(GPU_CULLING == 0 || ((UBO_TEST && !DYNAMIC_UBO) || SSBO_TEST), "GPU_CULLING passes the store slot through firstInstance, requires UBO_TEST without DYNAMIC_UBO, or SSBO_TEST");
+static_assert(GPU_CULLING == 0 || !(PARALLEL_RECORDING || STATIC_COMMAND_BUFFERS || CPU_FRUSTUM_CULLING), "GPU_CULLING replaces per draw recording, it can't be combined with PARALLEL_RECORDING, STATIC_COMMAND_BUFFERS or CPU_FRUSTUM_CULLING");
+static_assert(SORT_DRAWS == 0 || !(STATIC_COMMAND_BUFFERS || GPU_CULLING), "SORT_DRAWS reorders the recorded draw list every frame, it can't be used with STATIC_COMMAND_BUFFERS or GPU_CULLING");
+static_assert(FRAMES_IN_FLIGHT >= 1 && FRAMES_IN_FLIGHT <= 4, "FRAMES_IN_FLIGHT must be between 1 and 4");
+static_assert(FRAMES_IN_FLIGHT == 1 || (DEVICE_LOCAL && !DIRECT_TO_VRAM), "Buffers the gpu reads straight from mapped memory (DIRECT_TO_VRAM or !DEVICE_LOCAL) are single buffered, they need FRAMES_IN_FLIGHT 1");
+static_assert(QUANTIZED_VERTICES == 0 || !GPU_CULLING, "QUANTIZED_VERTICES pushes per mesh bounds with every draw, GPU_CULLING has no per draw push constants");
+static_assert(OCT_NORMAL_BITS == 16 || OCT_NORMAL_BITS == 8, "OCT_NORMAL_BITS must be 16 or 8");
+static_assert(COMPACT_INDICES == 0 || !GPU_CULLING, "GPU_CULLING merges every mesh into one 32 bit index buffer, it can't be used with COMPACT_INDICES");
+static_assert(MESHLET_MAX_VERTICES >= 3 && MESHLET_MAX_TRIANGLES >= 1, "A meshlet must be able to hold at least one triangle");
+static_assert(PIPELINE_THREADS >= 1, "PIPELINE_THREADS includes the main thread, must be at least 1");
+static_assert((FRAME_RING_SIZE & (FRAME_RING_SIZE - 1)) == 0, "FRAME_RING_SIZE must be a power of two so aligned ring offsets stay aligned when wrapping");
+static_assert(DEFRAGMENT == 0 || !(TLSF_ALLOCATOR || STATIC_COMMAND_BUFFERS || MESH_ARENA), "DEFRAGMENT moves individual mesh buffers in the pool allocator and swaps them under recorded draws, it can't be used with TLSF_ALLOCATOR, STATIC_COMMAND_BUFFERS or MESH_ARENA");
+static_assert(THREAD_CACHE_MAX_ALLOC_SIZE * 4 <= THREAD_CACHE_CHUNK_SIZE, "THREAD_CACHE_MAX_ALLOC_SIZE must be at most a quarter of THREAD_CACHE_CHUNK_SIZE, or chunks fill up after a couple of allocations");
+static_assert(DEFRAGMENT == 0 || !THREAD_SAFE_ALLOCATOR, "DEFRAGMENT works on the pool allocator's blocks directly and expects one buffer per allocation, it can't be used with THREAD_SAFE_ALLOCATOR");
 
 //Results
 /*
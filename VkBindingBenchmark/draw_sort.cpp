@@ -0,0 +1,166 @@
+#include "draw_sort.h"
+#include "shader_inputs.h"
+#include "os_init.h"
+#include <unordered_map>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+
+#define SORT_STATS_FRAMES 1024
+#define DEPTH_BUCKET_BITS 24
+#define MAX_SORT_DEPTH 3000.0f
+
+namespace draw_sort
+{
+	//pipeline, page and vertex buffer never change after init, only the depth bucket is rebuilt per sort
+	std::vector<uint64_t> staticKeys;
+	std::vector<glm::vec4> centers;
+	std::vector<uint32_t> pages;
+
+	std::vector<uint64_t> frameKeys;
+	std::vector<uint64_t> keysScratch;
+	std::vector<uint32_t> valuesScratch;
+
+	struct SortStats
+	{
+		uint32_t frames;
+		uint64_t rebinds;
+		double ms;
+	};
+
+	SortStats stats;
+
+	void init(const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& storeIdx)
+	{
+		//vertex buffers get small ids in first seen order, handles are too wide for the key
+		std::unordered_map<VkBuffer, uint32_t> bufferIds;
+
+		staticKeys.resize(drawCalls.size());
+		centers.resize(drawCalls.size());
+		pages.resize(drawCalls.size());
+
+		for (uint32_t i = 0; i < drawCalls.size(); ++i)
+		{
+			auto found = bufferIds.find(drawCalls[i].buffer);
+			uint32_t bufferId = found != bufferIds.end() ? found->second : static_cast<uint32_t>(bufferIds.size());
+			if (found == bufferIds.end())
+			{
+				bufferIds[drawCalls[i].buffer] = bufferId;
+			}
+
+			const uint64_t pipeline = 0;
+			pages[i] = storeIdx[i] & STORE_PAGE_MASK;
+
+			staticKeys[i] = (pipeline << 56) | ((uint64_t)pages[i] << 48) | ((uint64_t)(bufferId & 0xFFFFFF) << 24);
+			centers[i] = glm::vec4((drawCalls[i].min + drawCalls[i].max) * 0.5f, 1.0f);
+		}
+
+		stats = {};
+	}
+
+	void radixSort(uint64_t* keys, uint32_t* values, uint32_t count)
+	{
+		if (count < 2) return;
+
+		keysScratch.resize(count);
+		valuesScratch.resize(count);
+
+		//one read of the keys builds all 8 histograms
+		uint32_t histograms[8][256];
+		memset(histograms, 0, sizeof(histograms));
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint64_t key = keys[i];
+			for (uint32_t pass = 0; pass < 8; ++pass)
+			{
+				histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+			}
+		}
+
+		uint64_t* srcKeys = keys;
+		uint32_t* srcValues = values;
+		uint64_t* dstKeys = keysScratch.data();
+		uint32_t* dstValues = valuesScratch.data();
+
+		for (uint32_t pass = 0; pass < 8; ++pass)
+		{
+			uint32_t shift = pass * 8;
+			uint32_t* histogram = histograms[pass];
+
+			if (histogram[(srcKeys[0] >> shift) & 0xFF] == count) continue;
+
+			uint32_t offset = 0;
+			for (uint32_t b = 0; b < 256; ++b)
+			{
+				uint32_t bucketCount = histogram[b];
+				histogram[b] = offset;
+				offset += bucketCount;
+			}
+
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				uint32_t dst = histogram[(srcKeys[i] >> shift) & 0xFF]++;
+				dstKeys[dst] = srcKeys[i];
+				dstValues[dst] = srcValues[i];
+			}
+
+			std::swap(srcKeys, dstKeys);
+			std::swap(srcValues, dstValues);
+		}
+
+		if (srcKeys != keys)
+		{
+			memcpy(keys, srcKeys, sizeof(uint64_t) * count);
+			memcpy(values, srcValues, sizeof(uint32_t) * count);
+		}
+	}
+
+	void logStats(const uint32_t* order, uint32_t count, double ms)
+	{
+		uint32_t rebinds = 0;
+		uint32_t boundPage = 0xFFFFFFFF;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (pages[order[i]] != boundPage)
+			{
+				boundPage = pages[order[i]];
+				rebinds++;
+			}
+		}
+
+		stats.frames++;
+		stats.rebinds += rebinds;
+		stats.ms += ms;
+
+		if (stats.frames == SORT_STATS_FRAMES)
+		{
+			printf("DRAW SORT (avg of past %i frames): %f ms, %.0f descriptor binds for %u draws\n", SORT_STATS_FRAMES, stats.ms / stats.frames, stats.rebinds / (double)stats.frames, count);
+			stats = {};
+		}
+	}
+
+	void sort(const glm::mat4& view, uint32_t* inOutOrder, uint32_t count)
+	{
+		double start = OS::getMilliseconds();
+
+		const float depthScale = ((1 << DEPTH_BUCKET_BITS) - 1) / MAX_SORT_DEPTH;
+		const glm::vec4 viewZ = glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+
+		frameKeys.resize(count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t draw = inOutOrder[i];
+
+			//view space looks down -z
+			float depth = -glm::dot(viewZ, centers[draw]);
+			depth = depth < 0.0f ? 0.0f : (depth > MAX_SORT_DEPTH ? MAX_SORT_DEPTH : depth);
+
+			frameKeys[i] = staticKeys[draw] | (uint64_t)(depth * depthScale);
+		}
+
+		radixSort(frameKeys.data(), inOutOrder, count);
+
+		logStats(inOutOrder, count, OS::getMilliseconds() - start);
+	}
+}
\ No newline at end of file
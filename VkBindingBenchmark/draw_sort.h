@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "vkh_mesh.h"
+
+//Sorts the draw list by 64 bit keys so draws sharing a pipeline, store page and vertex buffer are recorded
+//together, front to back within each group. Keys, high bits to low:
+//	pipeline (8) | store page (8) | vertex buffer (24) | depth bucket (24)
+namespace draw_sort
+{
+	//builds the static part of every draw's key, call after the draw list's final order is set
+	void init(const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& storeIdx);
+
+	//sorts inOutOrder (indices into the draw list) by key, the depth bucket comes from view
+	void sort(const glm::mat4& view, uint32_t* inOutOrder, uint32_t count);
+
+	//stable LSD radix sort, 8 bits per pass, passes where every key has the same byte are skipped
+	void radixSort(uint64_t* keys, uint32_t* values, uint32_t count);
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "frame_allocator.h"
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace frame_allocator
+{
+	struct HostArena
+	{
+		char* base;
+		size_t used;
+	};
+
+	//head and tail count every byte ever handed out, including padding skipped when wrapping, so the space
+	//in use is always head - tail and an offset into the buffer is head % FRAME_RING_SIZE
+	struct DeviceRing
+	{
+		VkBuffer buffer;
+		vkh::Allocation alloc;
+		char* map;
+
+		uint64_t head;
+		uint64_t tail;
+
+		//head when each slot's last frame ended
+		uint64_t frameEnd[FRAMES_IN_FLIGHT];
+		uint32_t currentFrame;
+
+		bool warnedFull;
+	};
+
+	HostArena arena;
+	DeviceRing ring;
+
+	void init(vkh::VkhContext& ctxt)
+	{
+		arena.base = (char*)malloc(FRAME_HOST_ARENA_SIZE);
+		checkf(arena.base, "Allocation failed creating the frame host arena");
+		arena.used = 0;
+
+		vkh::createBuffer(
+			ring.buffer,
+			ring.alloc,
+			FRAME_RING_SIZE,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			ctxt);
+
+		ring.map = (char*)ring.alloc.map;
+
+		ring.head = 0;
+		ring.tail = 0;
+		memset(ring.frameEnd, 0, sizeof(ring.frameEnd));
+		ring.currentFrame = 0;
+		ring.warnedFull = false;
+	}
+
+	void beginFrame(uint32_t frameIndex)
+	{
+		arena.used = 0;
+
+		//frames retire in order, so the last frame that used this slot being done frees everything up to its watermark
+		ring.frameEnd[ring.currentFrame] = ring.head;
+		ring.tail = ring.frameEnd[frameIndex];
+		ring.currentFrame = frameIndex;
+	}
+
+	void* allocHost(size_t size, size_t alignment)
+	{
+		size_t offset = (arena.used + alignment - 1) & ~(alignment - 1);
+		checkf(offset + size <= FRAME_HOST_ARENA_SIZE, "Out of frame host arena memory, raise FRAME_HOST_ARENA_SIZE");
+
+		arena.used = offset + size;
+		return arena.base + offset;
+	}
+
+	bool allocDevice(VkDeviceSize size, VkDeviceSize alignment, DeviceAllocation& outAlloc)
+	{
+		uint64_t head = (ring.head + alignment - 1) & ~(alignment - 1);
+
+		//an allocation never straddles the end of the ring, the rest of the lap is skipped instead
+		uint64_t offset = head % FRAME_RING_SIZE;
+		if (offset + size > FRAME_RING_SIZE)
+		{
+			head += FRAME_RING_SIZE - offset;
+			offset = 0;
+		}
+
+		if (head + size - ring.tail > FRAME_RING_SIZE) return false;
+
+		ring.head = head + size;
+
+		outAlloc.buffer = ring.buffer;
+		outAlloc.offset = offset;
+		outAlloc.map = ring.map + offset;
+		return true;
+	}
+
+	void uploadToBuffer(VkBuffer& dst, uint32_t dstOffset, const void* data, uint32_t size, VkCommandBuffer* commandBuffer, vkh::VkhContext& ctxt)
+	{
+		DeviceAllocation staging;
+		if (!allocDevice(size, 16, staging))
+		{
+			if (!ring.warnedFull)
+			{
+				printf("Frame ring buffer full, falling back to temporary staging buffers. Raise FRAME_RING_SIZE\n");
+				ring.warnedFull = true;
+			}
+
+			vkh::copyDataToBuffer(&dst, size, dstOffset, (char*)data, ctxt);
+			return;
+		}
+
+		memcpy(staging.map, data, size);
+		vkh::copyBuffer(ring.buffer, dst, size, static_cast<uint32_t>(staging.offset), dstOffset, commandBuffer, ctxt);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include "vkh.h"
+
+//Memory that only has to live for a frame. The host side is a bump pointer arena that's reset every frame, the
+//device side is a persistently mapped ring buffer. Each frame slot remembers how far into the ring it wrote, and
+//once frame_pacer has waited on the slot's fence everything before that watermark can be handed out again.
+//Neither side allocates anything after init
+namespace frame_allocator
+{
+	struct DeviceAllocation
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		void* map;
+	};
+
+	void init(vkh::VkhContext& ctxt);
+
+	//call once the gpu is done with the last frame that used frameIndex, frame_pacer::beginFrame does this
+	void beginFrame(uint32_t frameIndex);
+
+	//valid until the next beginFrame, running out of FRAME_HOST_ARENA_SIZE is fatal
+	void* allocHost(size_t size, size_t alignment);
+
+	template<typename T>
+	T* allocHost(size_t count)
+	{
+		return (T*)allocHost(sizeof(T) * count, alignof(T));
+	}
+
+	//ring memory is host coherent, so writes through map don't need flushing. Returns false if the frames still
+	//in flight are holding too much of the ring for size bytes to fit
+	bool allocDevice(VkDeviceSize size, VkDeviceSize alignment, DeviceAllocation& outAlloc);
+
+	//copies data through the ring into dst, recorded on commandBuffer or on a scratch command buffer if it's null.
+	//if the ring is full this falls back to vkh::copyDataToBuffer and its temporary staging buffer
+	void uploadToBuffer(VkBuffer& dst, uint32_t dstOffset, const void* data, uint32_t size, VkCommandBuffer* commandBuffer, vkh::VkhContext& ctxt);
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "frame_pacer.h"
+#include "frame_allocator.h"
+#include "config.h"
+#include "os_init.h"
+#include <stdio.h>
+
+#define PACING_STATS_FRAMES 1024
+
+namespace frame_pacer
+{
+	FrameResources frames[FRAMES_IN_FLIGHT];
+	uint32_t current;
+
+	struct PacingStats
+	{
+		uint32_t frames;
+		double waitMs;
+		double lastFrameStart;
+		double frameMs;
+	};
+
+	PacingStats stats;
+
+	void init(vkh::VkhContext& ctxt)
+	{
+		//fences start signalled so the first wait on each slot falls straight through
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i)
+		{
+			vkh::createVkSemaphore(frames[i].imageAvailable, ctxt.device);
+			vkh::createVkSemaphore(frames[i].renderFinished, ctxt.device);
+
+			VkResult res = vkCreateFence(ctxt.device, &fenceInfo, nullptr, &frames[i].inFlight);
+			checkf(res == VK_SUCCESS, "Error creating frame fence");
+
+			vkh::createCommandPool(frames[i].commandPool, ctxt.device, ctxt.gpu, ctxt.gpu.graphicsQueueFamilyIdx);
+			vkh::createCommandBuffer(frames[i].commandBuffer, frames[i].commandPool, ctxt.device);
+		}
+
+		frame_allocator::init(ctxt);
+
+		//the first beginFrame steps to slot 0
+		current = FRAMES_IN_FLIGHT - 1;
+		stats = {};
+	}
+
+	//how long the cpu sat waiting for the gpu vs how long a frame took, a cpu bound frame waits ~0 ms
+	void logStats(double frameStart, double waitMs)
+	{
+		if (stats.lastFrameStart > 0.0)
+		{
+			stats.frameMs += frameStart - stats.lastFrameStart;
+			stats.waitMs += waitMs;
+			stats.frames++;
+		}
+		stats.lastFrameStart = frameStart;
+
+		if (stats.frames == PACING_STATS_FRAMES)
+		{
+			printf("FRAME PACING (%i frames in flight, avg of past %i frames): %f ms per frame, %f ms waiting on the gpu\n", FRAMES_IN_FLIGHT, PACING_STATS_FRAMES, stats.frameMs / stats.frames, stats.waitMs / stats.frames);
+
+			double lastFrameStart = stats.lastFrameStart;
+			stats = {};
+			stats.lastFrameStart = lastFrameStart;
+		}
+	}
+
+	FrameResources& beginFrame(vkh::VkhContext& ctxt)
+	{
+		current = (current + 1) % FRAMES_IN_FLIGHT;
+		FrameResources& frame = frames[current];
+
+		double frameStart = OS::getMilliseconds();
+
+		vkh::waitForFence(frame.inFlight, ctxt.device);
+		vkResetFences(ctxt.device, 1, &frame.inFlight);
+
+		logStats(frameStart, OS::getMilliseconds() - frameStart);
+
+		//everything recorded from this pool was part of the frame we just waited on
+		vkResetCommandPool(ctxt.device, frame.commandPool, 0);
+		frame_allocator::beginFrame(current);
+
+		return frame;
+	}
+
+	uint32_t getFrameIndex()
+	{
+		return current;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+#include "vkh.h"
+
+//Lets the cpu run at most FRAMES_IN_FLIGHT frames ahead of the gpu. Every frame slot owns its semaphores,
+//fence, command pool and upload region, and none of them are touched again until the slot's fence signals
+namespace frame_pacer
+{
+	struct FrameResources
+	{
+		VkSemaphore		imageAvailable;
+		VkSemaphore		renderFinished;
+		VkFence			inFlight;
+		VkCommandPool	commandPool;
+		VkCommandBuffer	commandBuffer;
+	};
+
+	void init(vkh::VkhContext& ctxt);
+
+	//moves to the next frame slot, blocking until the gpu has finished the last frame that used it,
+	//then resets the slot's fence and command pool
+	FrameResources& beginFrame(vkh::VkhContext& ctxt);
+
+	//the slot returned by the last beginFrame, stores use it to pick which upload region to write
+	uint32_t getFrameIndex();
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "frustum_culling.h"
+#include "os_init.h"
+#include <xmmintrin.h>
+#include <math.h>
+#include <stdio.h>
+
+#define CULL_STATS_FRAMES 1024
+
+namespace frustum_culling
+{
+	//padded to a multiple of 4, the padding lanes are masked off in cull()
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+
+	uint32_t numBounds;
+
+	struct CullStats
+	{
+		uint32_t frames;
+		uint64_t visible;
+		double ms;
+	};
+
+	CullStats stats;
+
+	void init(const std::vector<vkh::MeshAsset>& drawCalls)
+	{
+		numBounds = static_cast<uint32_t>(drawCalls.size());
+		uint32_t paddedCount = (numBounds + 3) & ~3;
+
+		centerX.resize(paddedCount, 0.0f);
+		centerY.resize(paddedCount, 0.0f);
+		centerZ.resize(paddedCount, 0.0f);
+		extentX.resize(paddedCount, 0.0f);
+		extentY.resize(paddedCount, 0.0f);
+		extentZ.resize(paddedCount, 0.0f);
+
+		for (uint32_t i = 0; i < numBounds; ++i)
+		{
+			glm::vec3 center = (drawCalls[i].min + drawCalls[i].max) * 0.5f;
+			glm::vec3 extent = (drawCalls[i].max - drawCalls[i].min) * 0.5f;
+
+			centerX[i] = center.x;
+			centerY[i] = center.y;
+			centerZ[i] = center.z;
+			extentX[i] = extent.x;
+			extentY[i] = extent.y;
+			extentZ[i] = extent.z;
+		}
+
+		stats = {};
+	}
+
+	//planes come out of the clip space bounds -w <= x,y <= w and 0 <= z <= w (vulkan depth range)
+	void extractPlanes(const glm::mat4& m, glm::vec4* outPlanes)
+	{
+		glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		outPlanes[0] = row3 + row0;
+		outPlanes[1] = row3 - row0;
+		outPlanes[2] = row3 + row1;
+		outPlanes[3] = row3 - row1;
+		outPlanes[4] = row2;
+		outPlanes[5] = row3 - row2;
+	}
+
+	void logStats(uint32_t visible, double ms)
+	{
+		stats.frames++;
+		stats.visible += visible;
+		stats.ms += ms;
+
+		if (stats.frames == CULL_STATS_FRAMES)
+		{
+			double avgVisible = stats.visible / (double)stats.frames;
+			printf("CPU CULL (avg of past %i frames): %.0f / %u visible, %.1f%% culled, %f ms\n",
+				CULL_STATS_FRAMES,
+				avgVisible,
+				numBounds,
+				numBounds > 0 ? 100.0 * (1.0 - avgVisible / numBounds) : 0.0,
+				stats.ms / stats.frames);
+
+			stats = {};
+		}
+	}
+
+	uint32_t cull(const glm::mat4& viewProj, uint32_t* outVisible)
+	{
+		double start = OS::getMilliseconds();
+
+		glm::vec4 planes[6];
+		extractPlanes(viewProj, planes);
+
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		__m128 absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+		for (uint32_t p = 0; p < 6; ++p)
+		{
+			planeX[p] = _mm_set1_ps(planes[p].x);
+			planeY[p] = _mm_set1_ps(planes[p].y);
+			planeZ[p] = _mm_set1_ps(planes[p].z);
+			planeW[p] = _mm_set1_ps(planes[p].w);
+			absPlaneX[p] = _mm_set1_ps(fabsf(planes[p].x));
+			absPlaneY[p] = _mm_set1_ps(fabsf(planes[p].y));
+			absPlaneZ[p] = _mm_set1_ps(fabsf(planes[p].z));
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		uint32_t numVisible = 0;
+
+		for (uint32_t i = 0; i < numBounds; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&centerX[i]);
+			__m128 cy = _mm_loadu_ps(&centerY[i]);
+			__m128 cz = _mm_loadu_ps(&centerZ[i]);
+			__m128 ex = _mm_loadu_ps(&extentX[i]);
+			__m128 ey = _mm_loadu_ps(&extentY[i]);
+			__m128 ez = _mm_loadu_ps(&extentZ[i]);
+
+			//a box is outside if it's fully behind any plane: dot(plane, center) + dot(|plane.xyz|, extent) < 0
+			__m128 outside = zero;
+			for (uint32_t p = 0; p < 6; ++p)
+			{
+				__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlaneX[p], ex), _mm_mul_ps(absPlaneY[p], ey)), _mm_mul_ps(absPlaneZ[p], ez));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+			}
+
+			int visibleMask = ~_mm_movemask_ps(outside) & 0xF;
+			uint32_t remaining = numBounds - i;
+			if (remaining < 4)
+			{
+				visibleMask &= (1 << remaining) - 1;
+			}
+
+			while (visibleMask)
+			{
+				uint32_t lane = 0;
+				while (!(visibleMask & (1 << lane))) lane++;
+
+				outVisible[numVisible++] = i + lane;
+				visibleMask &= visibleMask - 1;
+			}
+		}
+
+		logStats(numVisible, OS::getMilliseconds() - start);
+
+		return numVisible;
+	}
+}
\ No newline at end of file
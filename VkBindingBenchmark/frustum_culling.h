@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "vkh_mesh.h"
+
+//Frustum vs AABB culling over an SoA copy of the draw list's bounds, 4 boxes per SSE iteration
+namespace frustum_culling
+{
+	//bounds are indexed the same way as the draw list, so call this after the draw list's final order is set
+	void init(const std::vector<vkh::MeshAsset>& drawCalls);
+
+	//6 planes from the clip space bounds of viewProj, xyz point into the frustum
+	void extractPlanes(const glm::mat4& viewProj, glm::vec4* outPlanes);
+
+	//writes the indices of every draw that intersects the frustum to outVisible (sized >= the draw count), returns how many
+	uint32_t cull(const glm::mat4& viewProj, uint32_t* outVisible);
+}
\ No newline at end of file
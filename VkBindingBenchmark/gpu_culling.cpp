@@ -0,0 +1,293 @@
+#include "gpu_culling.h"
+#include "frustum_culling.h"
+#include "vkh_material.h"
+#include "vkh_initializers.h"
+#include "shader_inputs.h"
+#include "meshlet_builder.h"
+#include "config.h"
+
+#define CULL_SHADER_NAME "..\\data\\_generated\\builtshaders\\cull_draws.comp.spv"
+#define CULL_GROUP_SIZE 64
+
+namespace gpu_culling
+{
+	//matches DrawData in cull_draws.comp (std430)
+	struct DrawData
+	{
+		glm::vec4 center;
+		glm::vec4 extent;
+
+		//meshlet_builder::Meshlet::cone, w is 1 for whole draws so they're never cone culled
+		glm::vec4 cone;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t storeIdx;
+	};
+
+	struct CullPushConstants
+	{
+		glm::vec4 planes[6];
+		glm::vec4 cameraPos;
+		uint32_t numDraws;
+		uint32_t pageCapacity;
+		uint32_t pageBits;
+	};
+
+	//one entry per draw, or per meshlet with MESHLETS
+	uint32_t numDraws;
+	uint32_t numPages;
+
+	//each store page owns pageCapacity consecutive commands, a page's draws are compacted to the front of its range
+	uint32_t pageCapacity;
+
+	VkBuffer vertexBuf;
+	vkh::Allocation vertexAlloc;
+	VkBuffer indexBuf;
+	vkh::Allocation indexAlloc;
+
+	VkBuffer drawDataBuf;
+	vkh::Allocation drawDataAlloc;
+	VkBuffer commandBuf;
+	vkh::Allocation commandAlloc;
+	VkBuffer countBuf;
+	vkh::Allocation countAlloc;
+
+	VkDescriptorSetLayout descSetLayout;
+	VkDescriptorSet descSet;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	PFN_vkCmdDrawIndexedIndirectCountAMD drawIndexedIndirectCount;
+
+	void mergeGeometry(const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& storeIdx, std::vector<DrawData>& outDrawData, vkh::VkhContext& ctxt)
+	{
+		const uint32_t vertexSize = vkh::Mesh::vertexRenderData()->vertexSize;
+
+		VkDeviceSize vertexBytes = 0;
+		VkDeviceSize indexBytes = 0;
+		for (uint32_t i = 0; i < drawCalls.size(); ++i)
+		{
+			vertexBytes += drawCalls[i].vCount * vertexSize;
+			indexBytes += drawCalls[i].iCount * sizeof(uint32_t);
+		}
+
+		vkh::createBuffer(vertexBuf, vertexAlloc, vertexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ctxt);
+		vkh::createBuffer(indexBuf, indexAlloc, indexBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ctxt);
+
+		vkh::VkhCommandBuffer scratch = vkh::beginScratchCommandBuffer(vkh::ECommandPoolType::Transfer, ctxt);
+
+		uint32_t firstVertex = 0;
+		uint32_t firstIndex = 0;
+		for (uint32_t i = 0; i < drawCalls.size(); ++i)
+		{
+			const vkh::MeshAsset& mesh = drawCalls[i];
+
+			//arena meshes are addressed by vertexOffset / firstIndex within their block, standalone meshes by byte offset
+			VkBufferCopy vertexRegion = { mesh.vOffset + mesh.vertexOffset * vertexSize, firstVertex * vertexSize, mesh.vCount * vertexSize };
+			VkBufferCopy indexRegion = { mesh.iOffset + mesh.firstIndex * sizeof(uint32_t), firstIndex * sizeof(uint32_t), mesh.iCount * sizeof(uint32_t) };
+			vkCmdCopyBuffer(scratch.buffer, mesh.buffer, vertexBuf, 1, &vertexRegion);
+			vkCmdCopyBuffer(scratch.buffer, mesh.indexBuffer, indexBuf, 1, &indexRegion);
+
+#if MESHLETS
+			//meshlets are culled against a box around their sphere, the sphere's radius rides along in center.w for the cone test
+			const std::vector<meshlet_builder::Meshlet>& meshlets = meshlet_builder::getMeshlets();
+			for (uint32_t m = mesh.firstMeshlet; m < mesh.firstMeshlet + mesh.meshletCount; ++m)
+			{
+				DrawData data;
+				data.center = meshlets[m].sphere;
+				data.extent = glm::vec4(glm::vec3(meshlets[m].sphere.w), 0.0f);
+				data.cone = meshlets[m].cone;
+				data.indexCount = meshlets[m].indexCount;
+				data.firstIndex = firstIndex + meshlets[m].firstIndex;
+				data.vertexOffset = static_cast<int32_t>(firstVertex);
+				data.storeIdx = storeIdx[i];
+				outDrawData.push_back(data);
+			}
+#else
+			DrawData data;
+			data.center = glm::vec4((mesh.min + mesh.max) * 0.5f, 0.0f);
+			data.extent = glm::vec4((mesh.max - mesh.min) * 0.5f, 0.0f);
+			data.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			data.indexCount = mesh.iCount;
+			data.firstIndex = firstIndex;
+			data.vertexOffset = static_cast<int32_t>(firstVertex);
+			data.storeIdx = storeIdx[i];
+			outDrawData.push_back(data);
+#endif
+
+			firstVertex += mesh.vCount;
+			firstIndex += mesh.iCount;
+		}
+
+		vkh::submitScratchCommandBuffer(scratch);
+	}
+
+	void createPipeline(vkh::VkhContext& ctxt)
+	{
+		VkDescriptorSetLayoutBinding layoutBindings[3];
+		layoutBindings[0] = vkh::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1);
+		layoutBindings[1] = vkh::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1, 1);
+		layoutBindings[2] = vkh::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2, 1);
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = vkh::descriptorSetLayoutCreateInfo(&layoutBindings[0], 3);
+		VkResult res = vkCreateDescriptorSetLayout(ctxt.device, &layoutInfo, nullptr, &descSetLayout);
+		checkf(res == VK_SUCCESS, "Error creating draw culling desc set layout");
+
+		vkh::VkhMaterialCreateInfo createInfo = {};
+		createInfo.outPipeline = &pipeline;
+		createInfo.outPipelineLayout = &pipelineLayout;
+		createInfo.pushConstantStages = VK_SHADER_STAGE_COMPUTE_BIT;
+		createInfo.pushConstantRange = sizeof(CullPushConstants);
+		createInfo.descSetLayouts.push_back(descSetLayout);
+
+		vkh::createComputeMaterial(CULL_SHADER_NAME, ctxt, createInfo);
+
+		VkDescriptorSetAllocateInfo allocInfo = vkh::descriptorSetAllocateInfo(&descSetLayout, 1, ctxt.descriptorPool);
+		res = vkAllocateDescriptorSets(ctxt.device, &allocInfo, &descSet);
+		checkf(res == VK_SUCCESS, "Error allocating draw culling descriptor set");
+
+		VkDescriptorBufferInfo bufferInfos[3];
+		bufferInfos[0] = { drawDataBuf, 0, VK_WHOLE_SIZE };
+		bufferInfos[1] = { commandBuf, 0, VK_WHOLE_SIZE };
+		bufferInfos[2] = { countBuf, 0, VK_WHOLE_SIZE };
+
+		VkWriteDescriptorSet setWrites[3];
+		for (uint32_t b = 0; b < 3; ++b)
+		{
+			setWrites[b] = {};
+			setWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			setWrites[b].dstSet = descSet;
+			setWrites[b].dstBinding = b;
+			setWrites[b].dstArrayElement = 0;
+			setWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			setWrites[b].descriptorCount = 1;
+			setWrites[b].pBufferInfo = &bufferInfos[b];
+		}
+
+		vkUpdateDescriptorSets(ctxt.device, 3, &setWrites[0], 0, nullptr);
+	}
+
+	void init(const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& storeIdx, uint32_t numStorePages, vkh::VkhContext& ctxt)
+	{
+		checkf(ctxt.gpu.features.multiDrawIndirect && ctxt.gpu.features.drawIndirectFirstInstance, "GPU culling requires multiDrawIndirect and drawIndirectFirstInstance");
+
+		std::vector<DrawData> drawData;
+		drawData.reserve(drawCalls.size());
+		mergeGeometry(drawCalls, storeIdx, drawData, ctxt);
+
+		numDraws = static_cast<uint32_t>(drawData.size());
+		numPages = numStorePages;
+
+		//a page's range has to fit every draw that uses the page, even if all of them are visible
+		std::vector<uint32_t> drawsPerPage(numPages, 0);
+		for (uint32_t i = 0; i < numDraws; ++i)
+		{
+			drawsPerPage[drawData[i].storeIdx & STORE_PAGE_MASK]++;
+		}
+
+		pageCapacity = 0;
+		for (uint32_t p = 0; p < numPages; ++p)
+		{
+			pageCapacity = drawsPerPage[p] > pageCapacity ? drawsPerPage[p] : pageCapacity;
+		}
+
+		vkh::createBuffer(drawDataBuf, drawDataAlloc, sizeof(DrawData) * numDraws, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ctxt);
+		vkh::copyDataToBuffer(&drawDataBuf, sizeof(DrawData) * numDraws, 0, (char*)drawData.data(), ctxt);
+
+		vkh::createBuffer(commandBuf, commandAlloc, sizeof(VkDrawIndexedIndirectCommand) * pageCapacity * numPages, 
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ctxt);
+		vkh::createBuffer(countBuf, countAlloc, sizeof(uint32_t) * numPages,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ctxt);
+
+		createPipeline(ctxt);
+
+		drawIndexedIndirectCount = nullptr;
+		if (ctxt.gpu.supportsDrawIndirectCount)
+		{
+			drawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountAMD)vkGetDeviceProcAddr(ctxt.device, "vkCmdDrawIndexedIndirectCountAMD");
+		}
+
+		printf("GPU culling: %u %s in %u pages, %s\n", numDraws, MESHLETS ? "meshlets" : "draws", numPages, drawIndexedIndirectCount ? "using indirect count draws" : "no indirect count support, drawing full page ranges");
+	}
+
+	void dispatch(const glm::mat4& view, const glm::mat4& proj, VkCommandBuffer& commandBuffer, vkh::VkhContext& ctxt)
+	{
+		//has to come before the fills. with more than one frame in flight the previous frame's cull can still be
+		//writing the commands and counts, and its draws reading them
+		VkMemoryBarrier fillBarrier = {};
+		fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		fillBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		fillBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 1, &fillBarrier, 0, nullptr, 0, nullptr);
+
+		//zeroed commands have an instanceCount of 0, which is what the non count path relies on to skip culled entries
+		vkCmdFillBuffer(commandBuffer, countBuf, 0, VK_WHOLE_SIZE, 0);
+		if (!drawIndexedIndirectCount)
+		{
+			vkCmdFillBuffer(commandBuffer, commandBuf, 0, VK_WHOLE_SIZE, 0);
+		}
+
+		//chains off fillBarrier, so the cull also runs after last frame's indirect reads when there's nothing to fill
+		VkMemoryBarrier clearBarrier = {};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		CullPushConstants pc = {};
+		frustum_culling::extractPlanes(proj * view, &pc.planes[0]);
+		pc.cameraPos = glm::inverse(view)[3];
+		pc.numDraws = numDraws;
+		pc.pageCapacity = pageCapacity;
+		pc.pageBits = STORE_PAGE_BITS;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pc);
+		vkCmdDispatch(commandBuffer, (numDraws + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+		VkMemoryBarrier cullBarrier = {};
+		cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void draw(VkCommandBuffer& commandBuffer, VkPipelineLayout pipelineLayout, const VkDescriptorSet* pageSets)
+	{
+		VkDeviceSize vertexOffset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuf, &vertexOffset);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuf, 0, VK_INDEX_TYPE_UINT32);
+
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+		for (uint32_t p = 0; p < numPages; ++p)
+		{
+			VkDeviceSize commandOffset = p * pageCapacity * stride;
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &pageSets[p], 0, nullptr);
+
+			if (drawIndexedIndirectCount)
+			{
+				drawIndexedIndirectCount(commandBuffer, commandBuf, commandOffset, countBuf, p * sizeof(uint32_t), pageCapacity, stride);
+			}
+			else
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, commandBuf, commandOffset, pageCapacity, stride);
+			}
+		}
+	}
+}
\ No newline at end of file
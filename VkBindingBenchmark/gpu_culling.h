@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "vkh.h"
+#include "vkh_mesh.h"
+
+//GPU driven visibility: a compute pass culls every draw's bounds against the frustum and compacts the
+//survivors into per store page indirect command lists, so recording cost doesn't depend on scene size.
+//With MESHLETS every meshlet is culled (and backface cone tested) on its own instead of whole draws
+namespace gpu_culling
+{
+	//merges every draw's geometry into one vertex and one index buffer, and uploads the per draw cull data
+	void init(const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& storeIdx, uint32_t numStorePages, vkh::VkhContext& ctxt);
+
+	//records the cull and compaction dispatch, must be called outside of a render pass
+	void dispatch(const glm::mat4& view, const glm::mat4& proj, VkCommandBuffer& commandBuffer, vkh::VkhContext& ctxt);
+
+	//records one indirect draw per store page, pageSets[i] is the descriptor set for store page i
+	void draw(VkCommandBuffer& commandBuffer, VkPipelineLayout pipelineLayout, const VkDescriptorSet* pageSets);
+}
\ No newline at end of file
@@ -4,6 +4,16 @@
 #include "camera.h"
 #include "vkh.h"
 #include "config.h"
+#include "mapped_writer.h"
+#include "scene_graph.h"
+#include "frustum_culling.h"
+#include "gpu_culling.h"
+#include "draw_sort.h"
+#include "meshlet_builder.h"
+#include "shader_inputs.h"
+#include "alloc_replay.h"
+#include "memory_stats.h"
+#include "vkh_thread_cache.h"
 
 /*
 	Single threaded. Try to keep as much equal as possible, save for the experimental changes
@@ -22,8 +32,29 @@ std::vector<uint32_t> uboIdx;
 
 Camera::Cam worldCamera;
 
+#if SCENE_GRAPH
+//meshes are grouped under intermediate nodes, so animation has a real hierarchy to propagate through
+#define SCENE_GROUP_SIZE 64
+
+//data store index for each scene node, NO_PARENT for nodes that aren't drawn
+std::vector<uint32_t> nodeStoreIdx;
+
+void buildSceneGraph();
+void updateSceneGraph();
+#endif
+
 void mainLoop();
 
+#if DEFRAGMENT
+void onMeshMoved(void* user, VkBuffer newBuffer, const vkh::Allocation& newMemory)
+{
+	vkh::MeshAsset& mesh = testMesh[(uintptr_t)user];
+	mesh.buffer = newBuffer;
+	mesh.indexBuffer = newBuffer;
+	mesh.bufferMemory = newMemory;
+}
+#endif
+
 int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE pInstance, LPSTR cmdLine, int showCode)
 {
 	HWND wndHdl = OS::makeWindow(Instance, "Texture Array Demo", SCREEN_W, SCREEN_H);
@@ -45,11 +76,39 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE pInstance, LPSTR cmdLine, int
 
 	initContext(ctxtInfo, "Uniform Buffer Array Demo", Instance, wndHdl, appContext);
 
+#if ALLOCATOR_BENCHMARK || ALLOCATOR_CONTENTION_BENCHMARK
+	vkh::AllocatorInterface benchAllocators[] = { vkh::allocators::passthrough::allocImpl, vkh::allocators::pool::allocImpl, vkh::allocators::tlsf::allocImpl };
+	const char* benchNames[] = { "passthrough", "pool", "tlsf" };
+#endif
+
+#if ALLOCATOR_BENCHMARK
+	alloc_replay::runBenchmark(benchAllocators, benchNames, 3, appContext);
+#endif
+
+#if ALLOCATOR_CONTENTION_BENCHMARK
+	vkh::thread_cache::runContentionBenchmark(benchAllocators, benchNames, 3, appContext);
+#endif
+
+#if RECORD_ALLOC_TRACE
+	alloc_replay::startRecording(appContext);
+#endif
+
+#if FILL_BANDWIDTH_BENCHMARK
+	mapped_writer::runFillBenchmark(appContext);
+#endif
+
 	std::vector<vkh::EMeshVertexAttribute> meshLayout;
+#if QUANTIZED_VERTICES
+	meshLayout.push_back(vkh::EMeshVertexAttribute::POSITION_UNORM16);
+	meshLayout.push_back(vkh::EMeshVertexAttribute::UV0_HALF);
+	meshLayout.push_back(OCT_NORMAL_BITS == 16 ? vkh::EMeshVertexAttribute::NORMAL_OCT16 : vkh::EMeshVertexAttribute::NORMAL_OCT8);
+#else
 	meshLayout.push_back(vkh::EMeshVertexAttribute::POSITION);
 	meshLayout.push_back(vkh::EMeshVertexAttribute::UV0);
 	meshLayout.push_back(vkh::EMeshVertexAttribute::NORMAL);
+#endif
 	vkh::Mesh::setGlobalVertexLayout(meshLayout);
+	vkh::Mesh::setCompactIndices(COMPACT_INDICES);
 
 	//load a test obj mesh
 #if BISTRO_TEST
@@ -63,6 +122,21 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE pInstance, LPSTR cmdLine, int
 	uboIdx.resize(testMesh.size());
 
 	printf("Num meshes: %d\n", testMesh.size());
+#if MESH_ARENA
+	printf("Mesh arena blocks: %u\n", vkh::Mesh::getArenaBlockCount());
+#endif
+#if COMPACT_INDICES
+	uint32_t compactMeshes, totalMeshes;
+	VkDeviceSize indexBytesSaved;
+	vkh::Mesh::getIndexStats(compactMeshes, totalMeshes, indexBytesSaved);
+	printf("16 bit indices: %u of %u meshes, %.2f MB of index memory saved\n", compactMeshes, totalMeshes, indexBytesSaved / (1024.0 * 1024.0));
+#endif
+#if MESHLETS
+	uint32_t numMeshlets;
+	float avgTriangles, avgVertices, coneCullable;
+	meshlet_builder::getStats(numMeshlets, avgTriangles, avgVertices, coneCullable);
+	printf("Meshlets: %u, avg %.1f triangles / %.1f vertices, %.1f%% cone cullable\n", numMeshlets, avgTriangles, avgVertices, coneCullable * 100.0f);
+#endif
 
 	data_store::init(appContext);
 	
@@ -81,19 +155,101 @@ int CALLBACK WinMain(HINSTANCE Instance, HINSTANCE pInstance, LPSTR cmdLine, int
 
 		std::swap(testMesh[i], testMesh[newSlot]);
 		std::swap(uboIdx[i], uboIdx[newSlot]);
-	//	printf("%i\n", uboIdx[i] >> 3);
+	//	printf("%i\n", uboIdx[i] >> STORE_PAGE_BITS);
 
 	}
 
 #endif
 
+#if SCENE_GRAPH
+	buildSceneGraph();
+#endif
+
+#if CPU_FRUSTUM_CULLING
+	frustum_culling::init(testMesh);
+#endif
+
+#if SORT_DRAWS
+	draw_sort::init(testMesh, uboIdx);
+#endif
+
 	initRendering(appContext, testMesh.size());
 
+#if GPU_CULLING
+	gpu_culling::init(testMesh, uboIdx, data_store::getNumPages(), appContext);
+#endif
+
+	vkh::logPipelineCacheStats();
+	memory_stats::dump(appContext, "after load");
+
+#if DEFRAGMENT
+	//after the shuffle, so the index passed to the callback is the mesh's final slot
+	for (uint32_t i = 0; i < testMesh.size(); ++i)
+	{
+		vkh::Mesh::makeMovable(testMesh[i], onMeshMoved, (void*)(uintptr_t)i);
+	}
+#endif
+
+#if RECORD_ALLOC_TRACE
+	alloc_replay::saveRecording();
+#endif
+
 	mainLoop();
 
+	shutdownRendering();
+	vkh::savePipelineCache(appContext);
+
 	return 0;
 }
 
+#if SCENE_GRAPH
+void buildSceneGraph()
+{
+	uint32_t numGroups = (static_cast<uint32_t>(testMesh.size()) + SCENE_GROUP_SIZE - 1) / SCENE_GROUP_SIZE;
+	scene_graph::init(1 + numGroups + static_cast<uint32_t>(testMesh.size()));
+
+	uint32_t root = scene_graph::addNode(scene_graph::NO_PARENT, glm::mat4(1.0f), false);
+	nodeStoreIdx.push_back(scene_graph::NO_PARENT);
+
+	//mesh vertices are already in world space, so every rest transform is identity
+	uint32_t group = root;
+	for (uint32_t i = 0; i < testMesh.size(); ++i)
+	{
+		if (i % SCENE_GROUP_SIZE == 0)
+		{
+			group = scene_graph::addNode(root, glm::mat4(1.0f), false);
+			nodeStoreIdx.push_back(scene_graph::NO_PARENT);
+		}
+
+		//spreads the animated meshes evenly through the draw list
+		bool animated = (uint32_t)((i + 1) * ANIMATED_OBJECT_FRACTION) > (uint32_t)(i * ANIMATED_OBJECT_FRACTION);
+
+		scene_graph::addNode(group, glm::mat4(1.0f), animated);
+		nodeStoreIdx.push_back(uboIdx[i]);
+	}
+
+	printf("Scene graph: %u nodes, %u animated\n", scene_graph::getNumNodes(), scene_graph::getNumAnimatedNodes());
+}
+
+void updateSceneGraph()
+{
+	scene_graph::animate((float)(OS::getMilliseconds() * 0.001));
+	scene_graph::propagate();
+
+	uint32_t numChanged;
+	const uint32_t* changed = scene_graph::getChangedNodes(numChanged);
+
+	for (uint32_t i = 0; i < numChanged; ++i)
+	{
+		uint32_t storeIdx = nodeStoreIdx[changed[i]];
+		if (storeIdx != scene_graph::NO_PARENT)
+		{
+			data_store::setModelMatrix(storeIdx, scene_graph::getWorld(changed[i]));
+		}
+	}
+}
+#endif
+
 void logFPSAverage(double avg)
 {
 	printf("AVG FRAMETIME FOR LAST %i FRAMES: %f ms\n", FPS_DATA_FRAME_HISTORY_SIZE, avg);
@@ -134,6 +290,15 @@ void mainLoop()
 			break;
 		}
 		
+#if SCENE_GRAPH
+		updateSceneGraph();
+#endif
+
 		render(worldCamera, testMesh,uboIdx);
+		memory_stats::tick(appContext);
+
+#if DEFRAGMENT
+		vkh::allocators::pool::defragStep(appContext, DEFRAG_BUDGET_MS);
+#endif
 	}
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "mapped_writer.h"
+#include "os_init.h"
+#include <malloc.h>
+#include <string.h>
+#include <stdio.h>
+
+#define FILL_BENCHMARK_SIZE (32 * 1024 * 1024)
+#define FILL_BENCHMARK_ITERATIONS 16
+
+namespace mapped_writer
+{
+	double timeFill(char* dst, const char* src, VkDeviceSize size, bool streaming, VkDeviceMemory memory, bool coherent, vkh::VkhContext& ctxt)
+	{
+		VkMappedMemoryRange range = {};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = memory;
+		range.offset = 0;
+		range.size = VK_WHOLE_SIZE;
+
+		double start = OS::getMilliseconds();
+
+		for (uint32_t i = 0; i < FILL_BENCHMARK_ITERATIONS; ++i)
+		{
+			if (streaming)
+			{
+				streamCopy(dst, src, size);
+				streamFence();
+			}
+			else
+			{
+				memcpy(dst, src, size);
+			}
+
+			if (!coherent)
+			{
+				vkFlushMappedMemoryRanges(ctxt.device, 1, &range);
+			}
+		}
+
+		double ms = OS::getMilliseconds() - start;
+		return ((double)size * FILL_BENCHMARK_ITERATIONS) / (ms * 1000.0 * 1000.0);
+	}
+
+	void runFillBenchmark(vkh::VkhContext& ctxt)
+	{
+		const VkPhysicalDeviceMemoryProperties& memProps = ctxt.gpu.memProps;
+
+		char* src = (char*)_aligned_malloc(FILL_BENCHMARK_SIZE, CACHE_LINE_SIZE);
+		memset(src, 0xAB, FILL_BENCHMARK_SIZE);
+
+		printf("Fill bandwidth, %u MB x %u iterations (GB/s)\n", FILL_BENCHMARK_SIZE >> 20, FILL_BENCHMARK_ITERATIONS);
+
+		for (uint32_t typeIdx = 0; typeIdx < memProps.memoryTypeCount; ++typeIdx)
+		{
+			VkMemoryPropertyFlags flags = memProps.memoryTypes[typeIdx].propertyFlags;
+			if (!(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) continue;
+
+			//small heaps (ie: the 256 MB vram window) get a smaller test so we don't starve the app
+			VkDeviceSize heapSize = memProps.memoryHeaps[memProps.memoryTypes[typeIdx].heapIndex].size;
+			VkDeviceSize size = FILL_BENCHMARK_SIZE;
+			while (size > heapSize / 8 && size > CACHE_LINE_SIZE) size /= 2;
+
+			VkMemoryAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = size;
+			allocInfo.memoryTypeIndex = typeIdx;
+
+			VkDeviceMemory memory;
+			if (vkAllocateMemory(ctxt.device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+			{
+				printf("Type %u: allocation failed, skipping\n", typeIdx);
+				continue;
+			}
+
+			void* mapped;
+			vkMapMemory(ctxt.device, memory, 0, size, 0, &mapped);
+
+			bool coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+			//warm up, so the first run doesn't pay for page faults
+			memcpy(mapped, src, size);
+
+			double memcpyBandwidth = timeFill((char*)mapped, src, size, false, memory, coherent, ctxt);
+			double streamBandwidth = timeFill((char*)mapped, src, size, true, memory, coherent, ctxt);
+
+			printf("Type %u [%s%s%s]: memcpy %.2f, streaming %.2f\n",
+				typeIdx,
+				(flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? "DEVICE_LOCAL " : "",
+				(flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) ? "CACHED " : "UNCACHED ",
+				coherent ? "COHERENT" : "NON_COHERENT",
+				memcpyBandwidth,
+				streamBandwidth);
+
+			vkUnmapMemory(ctxt.device, memory);
+			vkFreeMemory(ctxt.device, memory, nullptr);
+		}
+
+		_aligned_free(src);
+	}
+}
\ No newline at end of file
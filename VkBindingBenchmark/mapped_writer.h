@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+#include <immintrin.h>
+#include "vkh.h"
+
+//Writes into mapped memory with full cache line non temporal stores, so write combined / uncached
+//mappings never get read from and cached mappings don't pull the destination into the cache
+namespace mapped_writer
+{
+	static const size_t CACHE_LINE_SIZE = 64;
+
+	//dst must be 32 byte aligned and size a multiple of CACHE_LINE_SIZE, src can have any alignment
+	inline void streamCopy(void* dst, const void* src, size_t size)
+	{
+		checkf(((uintptr_t)dst & 31) == 0, "Streaming store destination must be 32 byte aligned");
+		checkf((size % CACHE_LINE_SIZE) == 0, "Streaming store size must be a multiple of a cache line");
+
+		float* d = (float*)dst;
+		const float* s = (const float*)src;
+		const size_t numFloats = size / sizeof(float);
+
+		for (size_t i = 0; i < numFloats; i += CACHE_LINE_SIZE / sizeof(float))
+		{
+#ifdef __AVX__
+			_mm256_stream_ps(d + i, _mm256_loadu_ps(s + i));
+			_mm256_stream_ps(d + i + 8, _mm256_loadu_ps(s + i + 8));
+#else
+			_mm_stream_ps(d + i, _mm_loadu_ps(s + i));
+			_mm_stream_ps(d + i + 4, _mm_loadu_ps(s + i + 4));
+			_mm_stream_ps(d + i + 8, _mm_loadu_ps(s + i + 8));
+			_mm_stream_ps(d + i + 12, _mm_loadu_ps(s + i + 12));
+#endif
+		}
+	}
+
+	//streaming stores are weakly ordered, call once after the last streamCopy and before flushing / submitting
+	inline void streamFence()
+	{
+		_mm_sfence();
+	}
+
+	//prints memcpy vs streaming fill bandwidth for every host visible memory type
+	void runFillBenchmark(vkh::VkhContext& ctxt);
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "memory_stats.h"
+#include "config.h"
+#include "vkh_defrag.h"
+#include <stdio.h>
+
+#define STRATEGY_NAME_(x) #x
+#define STRATEGY_NAME(x) STRATEGY_NAME_(x)
+
+#define MB(bytes) ((bytes) / (1024.0 * 1024.0))
+
+namespace memory_stats
+{
+	uint32_t framesSinceDump = 0;
+
+	//budget is how much of each heap the driver thinks this process can use, usage is how much it is using,
+	//which includes memory the driver allocated on its behalf. Without the extension the budget is the heap size
+	bool getHeapBudgets(vkh::VkhContext& ctxt, VkDeviceSize* outBudget, VkDeviceSize* outUsage)
+	{
+		const VkPhysicalDeviceMemoryProperties& memProps = ctxt.gpu.memProps;
+
+		if (ctxt.gpu.supportsMemoryBudget)
+		{
+			static PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 =
+				(PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(ctxt.instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+			budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+			VkPhysicalDeviceMemoryProperties2KHR props = {};
+			props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+			props.pNext = &budget;
+			getMemoryProperties2(ctxt.gpu.device, &props);
+
+			for (uint32_t h = 0; h < memProps.memoryHeapCount; ++h)
+			{
+				outBudget[h] = budget.heapBudget[h];
+				outUsage[h] = budget.heapUsage[h];
+			}
+			return true;
+		}
+
+		for (uint32_t h = 0; h < memProps.memoryHeapCount; ++h)
+		{
+			outBudget[h] = memProps.memoryHeaps[h].size;
+			outUsage[h] = 0;
+		}
+		return false;
+	}
+
+	void printHistogram(const vkh::MemoryTypeStats& stats)
+	{
+		printf("      sizes:");
+		for (uint32_t b = 0; b < vkh::ALLOC_HISTOGRAM_BUCKETS; ++b)
+		{
+			if (stats.sizeHistogram[b] == 0) continue;
+
+			uint64_t lower = 1ull << (9 + b);
+			const char* more = b == vkh::ALLOC_HISTOGRAM_BUCKETS - 1 ? "+" : "";
+
+			if (b == 0) printf(" <1K:%u", stats.sizeHistogram[b]);
+			else if (lower < (1 << 20)) printf(" %lluK%s:%u", lower >> 10, more, stats.sizeHistogram[b]);
+			else printf(" %lluM%s:%u", lower >> 20, more, stats.sizeHistogram[b]);
+		}
+		printf("\n");
+	}
+
+	void dump(vkh::VkhContext& ctxt, const char* label)
+	{
+		const VkPhysicalDeviceMemoryProperties& memProps = ctxt.gpu.memProps;
+
+		VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS];
+		VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS];
+		bool hasBudget = getHeapBudgets(ctxt, heapBudget, heapUsage);
+
+		vkh::MemoryTypeStats typeStats[VK_MAX_MEMORY_TYPES];
+		for (uint32_t t = 0; t < memProps.memoryTypeCount; ++t)
+		{
+			ctxt.allocator.getStats(t, typeStats[t]);
+		}
+
+		printf("MEMORY (%s, %s allocator, %s):\n", label, ctxt.allocator.getName(), STRATEGY_NAME(data_store));
+
+		for (uint32_t h = 0; h < memProps.memoryHeapCount; ++h)
+		{
+			VkDeviceSize committed = 0;
+			VkDeviceSize used = 0;
+			for (uint32_t t = 0; t < memProps.memoryTypeCount; ++t)
+			{
+				if (memProps.memoryTypes[t].heapIndex != h) continue;
+				committed += typeStats[t].committed;
+				used += typeStats[t].used;
+			}
+
+			const bool deviceLocal = (memProps.memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+
+			if (hasBudget)
+			{
+				//usage also counts what other allocations in the process hold, so whichever is bigger is closer to the truth
+				VkDeviceSize inUse = heapUsage[h] > committed ? heapUsage[h] : committed;
+				printf("  Heap %u [%s]: committed %.2f MB, used %.2f MB, budget %.2f MB, process usage %.2f MB (%.1f%% of budget)\n",
+					h, deviceLocal ? "device local" : "host", MB(committed), MB(used), MB(heapBudget[h]), MB(heapUsage[h]), heapBudget[h] > 0 ? 100.0 * inUse / heapBudget[h] : 0.0);
+			}
+			else
+			{
+				printf("  Heap %u [%s]: committed %.2f MB, used %.2f MB, heap size %.2f MB (%.1f%% of heap, no budget extension)\n",
+					h, deviceLocal ? "device local" : "host", MB(committed), MB(used), MB(heapBudget[h]), heapBudget[h] > 0 ? 100.0 * committed / heapBudget[h] : 0.0);
+			}
+
+			for (uint32_t t = 0; t < memProps.memoryTypeCount; ++t)
+			{
+				const vkh::MemoryTypeStats& stats = typeStats[t];
+				if (memProps.memoryTypes[t].heapIndex != h || (stats.blockCount == 0 && stats.allocationCount == 0)) continue;
+
+				//external fragmentation: how much of the free space can't be handed out as one allocation
+				VkDeviceSize freeBytes = stats.committed > stats.used ? stats.committed - stats.used : 0;
+				double fragmentation = freeBytes > 0 ? 1.0 - stats.largestFreeSpan / (double)freeBytes : 0.0;
+
+				printf("    Type %u: committed %.2f MB, used %.2f MB, %u blocks, %u allocations, largest free span %.2f MB, fragmentation %.1f%%\n",
+					t, MB(stats.committed), MB(stats.used), stats.blockCount, stats.allocationCount, MB(stats.largestFreeSpan), fragmentation * 100.0);
+				printHistogram(stats);
+			}
+		}
+
+#if DEFRAGMENT
+		uint32_t movedBuffers, pendingFrees;
+		VkDeviceSize movedBytes;
+		vkh::defrag::getStats(movedBuffers, movedBytes, pendingFrees);
+		printf("  Defrag: moved %u buffers, %.2f MB, %u old buffers waiting to be freed\n", movedBuffers, MB(movedBytes), pendingFrees);
+#endif
+	}
+
+	void tick(vkh::VkhContext& ctxt)
+	{
+#if MEMORY_STATS_INTERVAL > 0
+		if (++framesSinceDump == MEMORY_STATS_INTERVAL)
+		{
+			framesSinceDump = 0;
+			dump(ctxt, "periodic");
+		}
+#endif
+	}
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+#include "vkh.h"
+
+//Where memory goes under the current allocator and data store: committed vs used bytes per heap and memory type,
+//blocks, free space fragmentation and allocation sizes, next to the driver's budget for each heap when
+//VK_EXT_memory_budget is available. Used to see how close a scene gets to running out of VRAM
+namespace memory_stats
+{
+	void dump(vkh::VkhContext& ctxt, const char* label);
+
+	//call once a frame, dumps every MEMORY_STATS_INTERVAL frames (never if it's 0)
+	void tick(vkh::VkhContext& ctxt);
+}
\ No newline at end of file
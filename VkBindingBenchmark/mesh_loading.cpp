@@ -1,10 +1,13 @@
 #include "mesh_loading.h"
 #include "vkh_mesh.h"
+#include "meshlet_builder.h"
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/Importer.hpp>
 #include "config.h"
+#include <float.h>
+#include <glm/gtc/packing.hpp>
 
 #if COMBINE_MESHES
 static const int defaultFlags =  aiProcess_JoinIdenticalVertices | aiProcess_PreTransformVertices | aiProcess_FlipWindingOrder | aiProcess_Triangulate;
@@ -12,6 +15,41 @@ static const int defaultFlags =  aiProcess_JoinIdenticalVertices | aiProcess_Pre
 static const int defaultFlags =  aiProcess_FlipWindingOrder | aiProcess_Triangulate;
 #endif
 
+template<typename T>
+static void append(std::vector<uint8_t>& buffer, T value)
+{
+	const uint8_t* bytes = (const uint8_t*)&value;
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static uint16_t quantizeUnorm16(float v)
+{
+	return (uint16_t)glm::round(glm::clamp(v, 0.0f, 1.0f) * 65535.0f);
+}
+
+//maps the unit sphere onto the [-1, 1] square, the lower hemisphere is folded out over the corners
+static glm::vec2 octEncode(glm::vec3 n)
+{
+	n /= (glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z));
+	glm::vec2 oct = glm::vec2(n.x, n.y);
+
+	if (n.z < 0.0f)
+	{
+		oct = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return oct;
+}
+
+static void meshBounds(const aiMesh* mesh, glm::vec3& inOutMin, glm::vec3& inOutMax)
+{
+	for (uint32_t vIdx = 0; vIdx < mesh->mNumVertices; ++vIdx)
+	{
+		const aiVector3D& pos = mesh->mVertices[vIdx];
+		inOutMin = glm::min(inOutMin, glm::vec3(pos.x, pos.y, pos.z));
+		inOutMax = glm::max(inOutMax, glm::vec3(pos.x, pos.y, pos.z));
+	}
+}
+
 std::vector<vkh::MeshAsset> loadMesh(const char* filepath, bool combineSubMeshes, vkh::VkhContext& ctxt)
 {
 	using namespace vkh;
@@ -33,37 +71,69 @@ std::vector<vkh::MeshAsset> loadMesh(const char* filepath, bool combineSubMeshes
 
 	if (scene)
 	{
-		uint32_t floatsPerVert = globalVertLayout->vertexSize / sizeof(float);
-		std::vector<float> vertexBuffer;
+		std::vector<uint8_t> vertexBuffer;
 		std::vector<uint32_t> indexBuffer;
 		uint32_t numVerts = 0;
+
+		//meshlets need full precision positions and normals whatever the vertex layout is
+		std::vector<glm::vec3> meshletPositions;
+		std::vector<glm::vec3> meshletNormals;
 		uint32_t numFaces = 0;
+		glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+		glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
 
 		outMeshes.resize(combineSubMeshes ? 1 : scene->mNumMeshes);
 
+		//quantized positions are stored relative to the bounds of the asset they end up in, so those are needed up front
+		glm::vec3 quantizeMin = glm::vec3(FLT_MAX);
+		glm::vec3 quantizeMax = glm::vec3(-FLT_MAX);
+		if (combineSubMeshes)
+		{
+			for (uint32_t mIdx = 0; mIdx < scene->mNumMeshes; mIdx++)
+			{
+				meshBounds(scene->mMeshes[mIdx], quantizeMin, quantizeMax);
+			}
+		}
+
 		for (uint32_t mIdx = 0; mIdx < scene->mNumMeshes; mIdx++)
 		{
 			if (!combineSubMeshes)
 			{
 				vertexBuffer.clear();
 				indexBuffer.clear();
+				meshletPositions.clear();
+				meshletNormals.clear();
 				numVerts = 0;
 				numFaces = 0;
+				boundsMin = glm::vec3(FLT_MAX);
+				boundsMax = glm::vec3(-FLT_MAX);
+
+				quantizeMin = glm::vec3(FLT_MAX);
+				quantizeMax = glm::vec3(-FLT_MAX);
+				meshBounds(scene->mMeshes[mIdx], quantizeMin, quantizeMax);
 			}
 
 			const aiMesh* mesh = scene->mMeshes[mIdx];
 			
 			for (uint32_t vIdx = 0; vIdx < mesh->mNumVertices; ++vIdx)
 			{
-				
+				size_t vertexStart = vertexBuffer.size();
+
 				const aiVector3D* pos = &(mesh->mVertices[vIdx]);
 				const aiVector3D* nrm = &(mesh->mNormals[vIdx]);
+#if MESHLETS
+				meshletPositions.push_back(glm::vec3(pos->x, pos->y, pos->z));
+				meshletNormals.push_back(glm::vec3(nrm->x, nrm->y, nrm->z));
+#endif
 				const aiVector3D* uv0 = mesh->HasTextureCoords(0) ? &(mesh->mTextureCoords[0][vIdx]) : &ZeroVector;
 				const aiVector3D* uv1 = mesh->HasTextureCoords(1) ? &(mesh->mTextureCoords[1][vIdx]) : &ZeroVector;
 				const aiVector3D* tan = mesh->HasTangentsAndBitangents() ? &(mesh->mTangents[vIdx]) : &ZeroVector;
 				const aiVector3D* biTan = mesh->HasTangentsAndBitangents() ? &(mesh->mBitangents[vIdx]) : &ZeroVector;
 				const aiColor4D* col = mesh->HasVertexColors(0) ? &(mesh->mColors[0][vIdx]) : &ZeroColor;
 
+				boundsMin = glm::min(boundsMin, glm::vec3(pos->x, pos->y, pos->z));
+				boundsMax = glm::max(boundsMax, glm::vec3(pos->x, pos->y, pos->z));
+
 				for (uint32_t lIdx = 0; lIdx < globalVertLayout->attrCount; ++lIdx)
 				{
 					EMeshVertexAttribute comp = globalVertLayout->attributes[lIdx];
@@ -72,49 +142,84 @@ std::vector<vkh::MeshAsset> loadMesh(const char* filepath, bool combineSubMeshes
 					{
 						case EMeshVertexAttribute::POSITION:
 						{
-							vertexBuffer.push_back(pos->x);
-							vertexBuffer.push_back(pos->y);
-							vertexBuffer.push_back(pos->z);
+							append(vertexBuffer, pos->x);
+							append(vertexBuffer, pos->y);
+							append(vertexBuffer, pos->z);
 						}; break;
 						case EMeshVertexAttribute::NORMAL:
 						{
-							vertexBuffer.push_back(nrm->x);
-							vertexBuffer.push_back(nrm->y);
-							vertexBuffer.push_back(nrm->z);
+							append(vertexBuffer, nrm->x);
+							append(vertexBuffer, nrm->y);
+							append(vertexBuffer, nrm->z);
 						}; break;
 						case EMeshVertexAttribute::UV0:
 						{
-							vertexBuffer.push_back(uv0->x);
-							vertexBuffer.push_back(uv0->y);
+							append(vertexBuffer, uv0->x);
+							append(vertexBuffer, uv0->y);
 						}; break;
 						case EMeshVertexAttribute::UV1:
 						{
-							vertexBuffer.push_back(uv1->x);
-							vertexBuffer.push_back(uv1->y);
+							append(vertexBuffer, uv1->x);
+							append(vertexBuffer, uv1->y);
 						}; break;
 						case EMeshVertexAttribute::TANGENT:
 						{
-							vertexBuffer.push_back(tan->x);
-							vertexBuffer.push_back(tan->y);
-							vertexBuffer.push_back(tan->z);
+							append(vertexBuffer, tan->x);
+							append(vertexBuffer, tan->y);
+							append(vertexBuffer, tan->z);
 						}; break;
 						case EMeshVertexAttribute::BITANGENT:
 						{
-							vertexBuffer.push_back(biTan->x);
-							vertexBuffer.push_back(biTan->y);
-							vertexBuffer.push_back(biTan->z);
+							append(vertexBuffer, biTan->x);
+							append(vertexBuffer, biTan->y);
+							append(vertexBuffer, biTan->z);
 						}; break;
 
 						case EMeshVertexAttribute::COLOR:
 						{
-							vertexBuffer.push_back(col->r);
-							vertexBuffer.push_back(col->g);
-							vertexBuffer.push_back(col->b);
-							vertexBuffer.push_back(col->a);
+							append(vertexBuffer, col->r);
+							append(vertexBuffer, col->g);
+							append(vertexBuffer, col->b);
+							append(vertexBuffer, col->a);
+						}; break;
+
+						case EMeshVertexAttribute::POSITION_UNORM16:
+						{
+							glm::vec3 range = quantizeMax - quantizeMin;
+							glm::vec3 rel = glm::vec3(pos->x, pos->y, pos->z) - quantizeMin;
+							append(vertexBuffer, quantizeUnorm16(range.x > 0.0f ? rel.x / range.x : 0.0f));
+							append(vertexBuffer, quantizeUnorm16(range.y > 0.0f ? rel.y / range.y : 0.0f));
+							append(vertexBuffer, quantizeUnorm16(range.z > 0.0f ? rel.z / range.z : 0.0f));
+							append(vertexBuffer, (uint16_t)0);
+						}; break;
+						case EMeshVertexAttribute::NORMAL_OCT16:
+						{
+							glm::vec2 oct = octEncode(glm::vec3(nrm->x, nrm->y, nrm->z));
+							append(vertexBuffer, (int16_t)glm::round(glm::clamp(oct.x, -1.0f, 1.0f) * 32767.0f));
+							append(vertexBuffer, (int16_t)glm::round(glm::clamp(oct.y, -1.0f, 1.0f) * 32767.0f));
+						}; break;
+						case EMeshVertexAttribute::NORMAL_OCT8:
+						{
+							glm::vec2 oct = octEncode(glm::vec3(nrm->x, nrm->y, nrm->z));
+							append(vertexBuffer, (int8_t)glm::round(glm::clamp(oct.x, -1.0f, 1.0f) * 127.0f));
+							append(vertexBuffer, (int8_t)glm::round(glm::clamp(oct.y, -1.0f, 1.0f) * 127.0f));
+						}; break;
+						case EMeshVertexAttribute::UV0_HALF:
+						{
+							append(vertexBuffer, (uint16_t)glm::packHalf1x16(uv0->x));
+							append(vertexBuffer, (uint16_t)glm::packHalf1x16(uv0->y));
+						}; break;
+						case EMeshVertexAttribute::UV1_HALF:
+						{
+							append(vertexBuffer, (uint16_t)glm::packHalf1x16(uv1->x));
+							append(vertexBuffer, (uint16_t)glm::packHalf1x16(uv1->y));
 						}; break;
 					}
 
 				}
+
+				//the layout's stride can be padded past the last attribute
+				vertexBuffer.resize(vertexStart + globalVertLayout->vertexSize, 0);
 			}
 
 			for (unsigned int fIdx = 0; fIdx < mesh->mNumFaces; fIdx++)
@@ -132,13 +237,31 @@ std::vector<vkh::MeshAsset> loadMesh(const char* filepath, bool combineSubMeshes
 
 			if (!combineSubMeshes)
 			{
+#if MESHLETS
+				outMeshes[mIdx].firstMeshlet = meshlet_builder::build(indexBuffer.data(), indexBuffer.size(), meshletPositions.data(), meshletNormals.data(), numVerts, outMeshes[mIdx].meshletCount);
+#endif
+#if MESH_ARENA
+				vkh::Mesh::makeInArena(outMeshes[mIdx], ctxt, vertexBuffer.data(), numVerts, indexBuffer.data(), indexBuffer.size());
+#else
 				vkh::Mesh::make(outMeshes[mIdx], ctxt, vertexBuffer.data(), numVerts, indexBuffer.data(), indexBuffer.size());
+#endif
+				outMeshes[mIdx].min = boundsMin;
+				outMeshes[mIdx].max = boundsMax;
 			}
 		}
 
 		if (combineSubMeshes)
 		{
+#if MESHLETS
+			outMeshes[0].firstMeshlet = meshlet_builder::build(indexBuffer.data(), indexBuffer.size(), meshletPositions.data(), meshletNormals.data(), numVerts, outMeshes[0].meshletCount);
+#endif
+#if MESH_ARENA
+			vkh::Mesh::makeInArena(outMeshes[0], ctxt, vertexBuffer.data(), numVerts, indexBuffer.data(), indexBuffer.size());
+#else
 			vkh::Mesh::make(outMeshes[0], ctxt, vertexBuffer.data(), numVerts, indexBuffer.data(), indexBuffer.size());
+#endif
+			outMeshes[0].min = boundsMin;
+			outMeshes[0].max = boundsMax;
 		}
 	}
 
@@ -0,0 +1,282 @@
+#include "meshlet_builder.h"
+#include "config.h"
+#include "debug.h"
+#include <float.h>
+#include <string.h>
+
+#define NO_TRIANGLE 0xFFFFFFFF
+
+//a cone this wide or wider has triangles close to edge on in it, it won't be culled often enough to be worth testing
+#define MIN_CONE_DOT 0.1f
+
+namespace meshlet_builder
+{
+	std::vector<Meshlet> meshlets;
+
+	//vertex -> triangle adjacency, triangles using vertex v are triLists[triOffsets[v] .. triOffsets[v + 1]]
+	std::vector<uint32_t> triOffsets;
+	std::vector<uint32_t> triLists;
+
+	//id of the last cluster each vertex was added to, ids start at 1 for every build
+	std::vector<uint32_t> vertexCluster;
+	std::vector<uint8_t> emitted;
+	std::vector<uint32_t> reordered;
+
+	struct Cluster
+	{
+		uint32_t id;
+		uint32_t vertexCount;
+		uint32_t triCount;
+		uint32_t vertices[MESHLET_MAX_VERTICES];
+
+		//sum of the cluster's vertex positions, ties between candidates go to the one closest to their average
+		glm::vec3 positionSum;
+	};
+
+	void buildAdjacency(const uint32_t* indices, uint32_t triCount, uint32_t vertexCount)
+	{
+		triOffsets.assign(vertexCount + 1, 0);
+		for (uint32_t i = 0; i < triCount * 3; ++i)
+		{
+			triOffsets[indices[i] + 1]++;
+		}
+
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			triOffsets[v + 1] += triOffsets[v];
+		}
+
+		//walks each vertex's write cursor forward, then shifts the offsets back into place
+		triLists.resize(triCount * 3);
+		for (uint32_t t = 0; t < triCount; ++t)
+		{
+			for (uint32_t k = 0; k < 3; ++k)
+			{
+				triLists[triOffsets[indices[t * 3 + k]]++] = t;
+			}
+		}
+
+		for (uint32_t v = vertexCount; v > 0; --v)
+		{
+			triOffsets[v] = triOffsets[v - 1];
+		}
+		triOffsets[0] = 0;
+	}
+
+	uint32_t newVertexCount(const Cluster& cluster, const uint32_t* tri)
+	{
+		uint32_t count = vertexCluster[tri[0]] != cluster.id;
+		count += vertexCluster[tri[1]] != cluster.id && tri[1] != tri[0];
+		count += vertexCluster[tri[2]] != cluster.id && tri[2] != tri[0] && tri[2] != tri[1];
+		return count;
+	}
+
+	//unemitted triangle touching one of vertices that adds the fewest new vertices to the cluster and still fits,
+	//closest to the cluster's center among equals so clusters grow as patches instead of strips
+	uint32_t bestNeighbour(const Cluster& cluster, const uint32_t* indices, const glm::vec3* positions, const uint32_t* vertices, uint32_t numVertices)
+	{
+		uint32_t best = NO_TRIANGLE;
+		uint32_t bestCost = 4;
+		float bestDistance = FLT_MAX;
+
+		const glm::vec3 center = cluster.positionSum / (float)cluster.vertexCount;
+
+		for (uint32_t i = 0; i < numVertices; ++i)
+		{
+			uint32_t v = vertices[i];
+			for (uint32_t a = triOffsets[v]; a < triOffsets[v + 1]; ++a)
+			{
+				uint32_t t = triLists[a];
+				if (emitted[t]) continue;
+
+				uint32_t cost = newVertexCount(cluster, &indices[t * 3]);
+				if (cost > bestCost || cluster.vertexCount + cost > MESHLET_MAX_VERTICES) continue;
+
+				const uint32_t* tri = &indices[t * 3];
+				glm::vec3 offset = (positions[tri[0]] + positions[tri[1]] + positions[tri[2]]) / 3.0f - center;
+				float distance = glm::dot(offset, offset);
+
+				if (cost < bestCost || distance < bestDistance)
+				{
+					best = t;
+					bestCost = cost;
+					bestDistance = distance;
+				}
+			}
+		}
+		return best;
+	}
+
+	void addTriangle(Cluster& cluster, const uint32_t* indices, const glm::vec3* positions, uint32_t t)
+	{
+		emitted[t] = 1;
+		cluster.triCount++;
+
+		for (uint32_t k = 0; k < 3; ++k)
+		{
+			uint32_t v = indices[t * 3 + k];
+			if (vertexCluster[v] != cluster.id)
+			{
+				vertexCluster[v] = cluster.id;
+				cluster.vertices[cluster.vertexCount++] = v;
+				cluster.positionSum += positions[v];
+			}
+			reordered.push_back(v);
+		}
+	}
+
+	void computeBounds(Meshlet& meshlet, const Cluster& cluster, const uint32_t* clusterIndices, const glm::vec3* positions, const glm::vec3* normals)
+	{
+		glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+		glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+		for (uint32_t i = 0; i < cluster.vertexCount; ++i)
+		{
+			boundsMin = glm::min(boundsMin, positions[cluster.vertices[i]]);
+			boundsMax = glm::max(boundsMax, positions[cluster.vertices[i]]);
+		}
+
+		glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i = 0; i < cluster.vertexCount; ++i)
+		{
+			radius = glm::max(radius, glm::length(positions[cluster.vertices[i]] - center));
+		}
+		meshlet.sphere = glm::vec4(center, radius);
+
+		//face normals are flipped to agree with the vertex normals rather than trusting a winding convention
+		glm::vec3 faceNormals[MESHLET_MAX_TRIANGLES];
+		uint32_t numNormals = 0;
+		glm::vec3 axis = glm::vec3(0.0f);
+
+		for (uint32_t t = 0; t < cluster.triCount; ++t)
+		{
+			const uint32_t* tri = &clusterIndices[t * 3];
+			glm::vec3 n = glm::cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]);
+			float len = glm::length(n);
+			if (len <= 0.0f) continue;
+
+			n /= len;
+			if (glm::dot(n, normals[tri[0]] + normals[tri[1]] + normals[tri[2]]) < 0.0f)
+			{
+				n = -n;
+			}
+
+			faceNormals[numNormals++] = n;
+			axis += n;
+		}
+
+		meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+		float axisLen = glm::length(axis);
+		if (numNormals == 0 || axisLen <= 0.0f) return;
+		axis /= axisLen;
+
+		float minDot = 1.0f;
+		for (uint32_t i = 0; i < numNormals; ++i)
+		{
+			minDot = glm::min(minDot, glm::dot(faceNormals[i], axis));
+		}
+
+		//every normal is within acos(minDot) of the axis, so the view direction has to be within 90 - that of it
+		if (minDot > MIN_CONE_DOT)
+		{
+			meshlet.cone = glm::vec4(axis, glm::sqrt(1.0f - minDot * minDot));
+		}
+	}
+
+	uint32_t build(uint32_t* indices, uint32_t indexCount, const glm::vec3* positions, const glm::vec3* normals, uint32_t vertexCount, uint32_t& outMeshletCount)
+	{
+		checkf(indexCount % 3 == 0, "Meshlets can only be built from triangle lists");
+
+		const uint32_t triCount = indexCount / 3;
+		const uint32_t firstMeshlet = static_cast<uint32_t>(meshlets.size());
+
+		buildAdjacency(indices, triCount, vertexCount);
+		vertexCluster.assign(vertexCount, 0);
+		emitted.assign(triCount, 0);
+		reordered.clear();
+		reordered.reserve(indexCount);
+
+		Cluster cluster;
+		cluster.id = 0;
+
+		uint32_t seed = 0;
+		uint32_t remaining = triCount;
+
+		while (remaining > 0)
+		{
+			cluster.id++;
+			cluster.vertexCount = 0;
+			cluster.triCount = 0;
+			cluster.positionSum = glm::vec3(0.0f);
+
+			uint32_t firstIndex = static_cast<uint32_t>(reordered.size());
+
+			while (emitted[seed]) seed++;
+			uint32_t next = seed;
+
+			while (next != NO_TRIANGLE)
+			{
+				addTriangle(cluster, indices, positions, next);
+				remaining--;
+
+				if (cluster.triCount == MESHLET_MAX_TRIANGLES || remaining == 0) break;
+
+				//neighbours of the newest triangle first, then of anything in the cluster
+				next = bestNeighbour(cluster, indices, positions, &indices[next * 3], 3);
+				if (next == NO_TRIANGLE)
+				{
+					next = bestNeighbour(cluster, indices, positions, cluster.vertices, cluster.vertexCount);
+				}
+
+				//disconnected pieces (foliage cards and the like) are packed in index order, which usually keeps them close
+				if (next == NO_TRIANGLE)
+				{
+					while (emitted[seed]) seed++;
+					if (cluster.vertexCount + newVertexCount(cluster, &indices[seed * 3]) <= MESHLET_MAX_VERTICES)
+					{
+						next = seed;
+					}
+				}
+			}
+
+			Meshlet meshlet;
+			meshlet.firstIndex = firstIndex;
+			meshlet.indexCount = cluster.triCount * 3;
+			meshlet.vertexCount = cluster.vertexCount;
+			meshlet.pad = 0;
+			computeBounds(meshlet, cluster, &reordered[firstIndex], positions, normals);
+
+			meshlets.push_back(meshlet);
+		}
+
+		memcpy(indices, reordered.data(), sizeof(uint32_t) * indexCount);
+
+		outMeshletCount = static_cast<uint32_t>(meshlets.size()) - firstMeshlet;
+		return firstMeshlet;
+	}
+
+	const std::vector<Meshlet>& getMeshlets()
+	{
+		return meshlets;
+	}
+
+	void getStats(uint32_t& outMeshlets, float& outAvgTriangles, float& outAvgVertices, float& outConeCullable)
+	{
+		uint64_t triangles = 0;
+		uint64_t vertices = 0;
+		uint32_t cullable = 0;
+
+		for (const Meshlet& m : meshlets)
+		{
+			triangles += m.indexCount / 3;
+			vertices += m.vertexCount;
+			cullable += m.cone.w < 1.0f;
+		}
+
+		outMeshlets = static_cast<uint32_t>(meshlets.size());
+		outAvgTriangles = outMeshlets > 0 ? triangles / (float)outMeshlets : 0.0f;
+		outAvgVertices = outMeshlets > 0 ? vertices / (float)outMeshlets : 0.0f;
+		outConeCullable = outMeshlets > 0 ? cullable / (float)outMeshlets : 0.0f;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+//Splits a mesh's triangle list into clusters of at most MESHLET_MAX_VERTICES unique vertices and MESHLET_MAX_TRIANGLES
+//triangles, grown across shared vertices so they stay spatially compact. Every cluster gets a bounding sphere and a
+//normal cone, so it can be culled against the frustum, or rejected when all of its triangles face away from the camera
+namespace meshlet_builder
+{
+	struct Meshlet
+	{
+		//xyz center, w radius
+		glm::vec4 sphere;
+
+		//xyz axis the triangle normals spread around, w cutoff. the cluster is backfacing if
+		//dot(center - camera, axis) >= cutoff * length(center - camera) + radius, a cutoff of 1 never culls
+		glm::vec4 cone;
+
+		//relative to the first index of the mesh the cluster was built from
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t vertexCount;
+		uint32_t pad;
+	};
+
+	//reorders indices in place so each cluster's triangles are contiguous and appends the clusters to the global list,
+	//returns the index of the first one. positions / normals are indexed by the same vertex indices as indices
+	uint32_t build(uint32_t* indices, uint32_t indexCount, const glm::vec3* positions, const glm::vec3* normals, uint32_t vertexCount, uint32_t& outMeshletCount);
+
+	const std::vector<Meshlet>& getMeshlets();
+
+	//averages over every cluster built so far, coneCullable is the fraction that can be backface culled at all
+	void getStats(uint32_t& outMeshlets, float& outAvgTriangles, float& outAvgVertices, float& outConeCullable);
+}
\ No newline at end of file
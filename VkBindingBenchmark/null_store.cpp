@@ -7,7 +7,9 @@ namespace null_store
 	bool acquire(uint32_t& outIdx) { return true; }
 	uint32_t getNumPages() { return 0; }
 	VkBuffer& getPage(uint32_t idx) { VkBuffer buf; return buf; }
+	bool isCopyTarget(uint32_t idx) { return false; }
 	vkh::Allocation& getAlloc(uint32_t idx) { vkh::Allocation alloc = {}; return alloc; }
+	void setModelMatrix(uint32_t idx, const glm::mat4& model) {}
 
 	void updateBuffers(const glm::mat4& viewMatrix, const glm::mat4& projMatrix, VkCommandBuffer* commandBuffer, vkh::VkhContext& ctxt) {}
 	VkDescriptorType getDescriptorType() { return VK_DESCRIPTOR_TYPE_MAX_ENUM; }
@@ -9,17 +9,47 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/glm.hpp>
 #include "shader_inputs.h"
+#include "thread_pool.h"
+#include "frustum_culling.h"
+#include "gpu_culling.h"
+#include "draw_sort.h"
+#include "command_recorder.h"
+#include "frame_pacer.h"
 
 struct RenderingData
 {
 	vkh::VkhContext*				owningContext;
 	std::vector<VkFramebuffer>		frameBuffers;
-	std::vector<VkCommandBuffer>	commandBuffers;
 	vkh::VkhRenderBuffer			depthBuffer;
 	VkRenderPass					mainRenderPass;
 
 	VkBuffer						ubo;
 	vkh::Allocation					uboAlloc;
+
+	//VShaderInput size rounded up to minUniformBufferOffsetAlignment, the stride between dynamic ubo slots
+	uint32_t						dynamicAlignment;
+
+#if ASYNC_TRANSFER_QUEUE
+	vkh::VkhAsyncTransfer			asyncTransfer;
+#endif
+
+#if PARALLEL_RECORDING
+	//one pool and secondary per recording thread per frame in flight, indexed [frame * RECORDING_THREADS + chunk]
+	std::vector<VkCommandPool>		workerPools;
+	std::vector<VkCommandBuffer>	workerCommandBuffers;
+	uint32_t						activeWorkers;
+#endif
+
+#if CPU_FRUSTUM_CULLING || SORT_DRAWS
+	//indices into the draw list, in the order they get recorded
+	std::vector<uint32_t>			drawList;
+#endif
+
+#if STATIC_COMMAND_BUFFERS
+	//the scene draws, recorded once and executed by every frame's primary
+	VkCommandBuffer					staticSceneCommandBuffer;
+	bool							staticSceneRecorded;
+#endif
 };
 
 RenderingData appData;
@@ -39,7 +69,40 @@ void createDepthBuffer();
 void loadDebugMaterial();
 void loadUBOTestMaterial(int num);
 void createGlobalShaderData();
-int bindDescriptorSets(int curPage, int pageToBind, int slotToBind, VkCommandBuffer& cmd);
+int bindDescriptorSets(int curPage, int pageToBind, int slotToBind, command_recorder::Recorder& rec);
+void recordDraws(VkCommandBuffer& cmd, const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& uboIdx, const uint32_t* drawOrder, uint32_t first, uint32_t last, const glm::mat4& view, const glm::mat4& proj);
+
+#if WITH_VK_TIMESTAMP
+void logGpuTime(uint32_t frameIndex);
+#endif
+
+#if PIPELINE_PERMUTATIONS
+void createPipelinePermutations();
+#endif
+
+#if PARALLEL_RECORDING
+#define RECORDING_FRAMES_PER_STEP 1024
+
+struct RecordJob
+{
+	const std::vector<vkh::MeshAsset>*	drawCalls;
+	const std::vector<uint32_t>*		uboIdx;
+	const uint32_t*						drawOrder;
+	uint32_t							numDraws;
+	glm::mat4							view;
+	glm::mat4							proj;
+	uint32_t							imageIndex;
+	uint32_t							frameIndex;
+	uint32_t							numChunks;
+};
+
+void recordChunk(uint32_t chunk, void* data);
+void logRecordingTime(double ms);
+#endif
+
+#if STATIC_COMMAND_BUFFERS
+void recordStaticScene(const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& uboIdx);
+#endif
 
 void initRendering(vkh::VkhContext& context, uint32_t num)
 {
@@ -50,13 +113,44 @@ void initRendering(vkh::VkhContext& context, uint32_t num)
 
 	vkh::createFrameBuffers(appData.frameBuffers, context.swapChain, &appData.depthBuffer.view, appData.mainRenderPass, context.device);
 
-	uint32_t swapChainImageCount = static_cast<uint32_t>(context.swapChain.imageViews.size());
-	appData.commandBuffers.resize(swapChainImageCount);
-	for (uint32_t i = 0; i < swapChainImageCount; ++i)
+	frame_pacer::init(context);
+
+#if ASYNC_TRANSFER_QUEUE
+	vkh::createAsyncTransfer(appData.asyncTransfer, FRAMES_IN_FLIGHT, context);
+
+	//every page has been created by now, the descriptor sets below are built from the same list
+	for (uint32_t i = 0; i < data_store::getNumPages(); ++i)
+	{
+		if (data_store::isCopyTarget(i))
+		{
+			vkh::addAsyncTransferTarget(appData.asyncTransfer, data_store::getPage(i), context);
+		}
+	}
+#endif
+
+#if PARALLEL_RECORDING
+	thread_pool::init(RECORDING_THREADS - 1);
+
+	appData.workerPools.resize(FRAMES_IN_FLIGHT * RECORDING_THREADS);
+	appData.workerCommandBuffers.resize(FRAMES_IN_FLIGHT * RECORDING_THREADS);
+	for (uint32_t i = 0; i < appData.workerPools.size(); ++i)
 	{
-		vkh::createCommandBuffer(appData.commandBuffers[i], context.gfxCommandPool, context.device);
+		vkh::createCommandPool(appData.workerPools[i], context.device, context.gpu, context.gpu.graphicsQueueFamilyIdx);
+		vkh::createSecondaryCommandBuffer(appData.workerCommandBuffers[i], appData.workerPools[i], context.device);
 	}
 
+	appData.activeWorkers = 1;
+#endif
+
+#if STATIC_COMMAND_BUFFERS
+	vkh::createSecondaryCommandBuffer(appData.staticSceneCommandBuffer, context.gfxCommandPool, context.device);
+	appData.staticSceneRecorded = false;
+#endif
+
+#if PIPELINE_PERMUTATIONS
+	createPipelinePermutations();
+#endif
+
 #if PUSH_TEST
 	loadDebugMaterial();
 #else
@@ -64,6 +158,136 @@ void initRendering(vkh::VkhContext& context, uint32_t num)
 #endif
 }
 
+//waits for the gpu to finish with every frame in flight, then stops the threads initRendering started
+void shutdownRendering()
+{
+	vkDeviceWaitIdle(appData.owningContext->device);
+
+#if PARALLEL_RECORDING
+	thread_pool::shutdown();
+#endif
+}
+
+#if PIPELINE_PERMUTATIONS
+//builds the pipeline for every binding strategy / fragment shader pair that works with the current vertex layout, then
+//throws them away. they all end up in the pipeline cache, so a sweep over those configurations starts warm
+void createPipelinePermutations()
+{
+	vkh::VkhContext& ctxt = *appData.owningContext;
+
+	struct Strategy
+	{
+		const char* vShaderPath;
+
+		//VK_DESCRIPTOR_TYPE_MAX_ENUM for shaders that don't use a descriptor set
+		VkDescriptorType descType;
+		uint32_t pushConstantRange;
+	};
+
+#if QUANTIZED_VERTICES
+	const Strategy strategies[] =
+	{
+		{ "..\\data\\_generated\\builtshaders\\ubo_array_quantized.vert.spv", VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sizeof(QuantizedPushConstants) },
+		{ "..\\data\\_generated\\builtshaders\\dynamic_ubo_quantized.vert.spv", VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, sizeof(QuantizedPushConstants) },
+		{ "..\\data\\_generated\\builtshaders\\ssbo_array_quantized.vert.spv", VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sizeof(QuantizedPushConstants) },
+		{ "..\\data\\_generated\\builtshaders\\common_vert_quantized.vert.spv", VK_DESCRIPTOR_TYPE_MAX_ENUM, sizeof(glm::mat4) * 2 },
+	};
+#else
+	const Strategy strategies[] =
+	{
+		{ "..\\data\\_generated\\builtshaders\\ubo_array.vert.spv", VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sizeof(uint32_t) },
+		{ "..\\data\\_generated\\builtshaders\\dynamic_ubo.vert.spv", VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, sizeof(uint32_t) },
+		{ "..\\data\\_generated\\builtshaders\\ssbo_array.vert.spv", VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sizeof(uint32_t) },
+		{ "..\\data\\_generated\\builtshaders\\ssbo_array_511.vert.spv", VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sizeof(uint32_t) },
+		{ "..\\data\\_generated\\builtshaders\\common_vert.vert.spv", VK_DESCRIPTOR_TYPE_MAX_ENUM, sizeof(glm::mat4) * 2 },
+#if GPU_CULLING
+		//the indirect shaders take the store slot from firstInstance and don't read push constants. the range is
+		//still there so the layout matches the one loadUBOTestMaterial builds for them
+		{ "..\\data\\_generated\\builtshaders\\ubo_array_indirect.vert.spv", VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sizeof(uint32_t) },
+		{ "..\\data\\_generated\\builtshaders\\ssbo_array_indirect.vert.spv", VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sizeof(uint32_t) },
+#endif
+	};
+#endif
+
+	const char* fShaderPaths[] =
+	{
+		"..\\data\\_generated\\builtshaders\\random_frag.frag.spv",
+		"..\\data\\_generated\\builtshaders\\debug_normals.frag.spv",
+		"..\\data\\_generated\\builtshaders\\debug_uvs.frag.spv",
+	};
+
+	const uint32_t numStrategies = sizeof(strategies) / sizeof(Strategy);
+	const uint32_t numFragShaders = sizeof(fShaderPaths) / sizeof(const char*);
+
+	//one set layout per descriptor type, shared by every strategy that binds that type
+	const VkDescriptorType setTypes[] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+	VkDescriptorSetLayout setLayouts[3];
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		VkDescriptorSetLayoutBinding layoutBinding = vkh::descriptorSetLayoutBinding(setTypes[i], VK_SHADER_STAGE_VERTEX_BIT, 0, 1);
+		VkDescriptorSetLayoutCreateInfo layoutInfo = vkh::descriptorSetLayoutCreateInfo(&layoutBinding, 1);
+
+		VkResult res = vkCreateDescriptorSetLayout(ctxt.device, &layoutInfo, nullptr, &setLayouts[i]);
+		checkf(res == VK_SUCCESS, "Error creating permutation desc set layout");
+	}
+
+	std::vector<VkPipeline> pipelines(numStrategies * numFragShaders);
+	std::vector<VkPipelineLayout> pipelineLayouts(numStrategies * numFragShaders);
+	std::vector<vkh::VkhMaterialBatchEntry> entries(numStrategies * numFragShaders);
+
+	for (uint32_t s = 0; s < numStrategies; ++s)
+	{
+		for (uint32_t f = 0; f < numFragShaders; ++f)
+		{
+			uint32_t idx = s * numFragShaders + f;
+
+			vkh::VkhMaterialBatchEntry& entry = entries[idx];
+			entry.vShaderPath = strategies[s].vShaderPath;
+			entry.fShaderPath = fShaderPaths[f];
+			entry.createInfo.renderPass = appData.mainRenderPass;
+			entry.createInfo.outPipeline = &pipelines[idx];
+			entry.createInfo.outPipelineLayout = &pipelineLayouts[idx];
+			entry.createInfo.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+			entry.createInfo.pushConstantRange = strategies[s].pushConstantRange;
+
+			for (uint32_t t = 0; t < 3; ++t)
+			{
+				if (setTypes[t] == strategies[s].descType)
+				{
+					entry.createInfo.descSetLayouts.push_back(setLayouts[t]);
+				}
+			}
+		}
+	}
+
+	//PARALLEL_RECORDING's pool is already running by now, otherwise borrow one just for the batch
+	bool ownsPool = thread_pool::getNumWorkers() == 0;
+	if (ownsPool)
+	{
+		thread_pool::init(PIPELINE_THREADS - 1);
+	}
+
+	vkh::createBasicMaterials(entries, ctxt);
+
+	if (ownsPool)
+	{
+		thread_pool::shutdown();
+	}
+
+	for (uint32_t i = 0; i < pipelines.size(); ++i)
+	{
+		vkDestroyPipeline(ctxt.device, pipelines[i], nullptr);
+		vkDestroyPipelineLayout(ctxt.device, pipelineLayouts[i], nullptr);
+	}
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		vkDestroyDescriptorSetLayout(ctxt.device, setLayouts[i], nullptr);
+	}
+}
+#endif
+
 void createGlobalShaderData()
 {
 
@@ -74,6 +298,9 @@ static VkWriteDescriptorSet setWrite;
 
 void loadUBOTestMaterial(int num)
 {
+	size_t uboAlignment = appData.owningContext->gpu.deviceProps.limits.minUniformBufferOffsetAlignment;
+	appData.dynamicAlignment = static_cast<uint32_t>(((sizeof(VShaderInput) + uboAlignment - 1) / uboAlignment) * uboAlignment);
+
 	//create descriptor set layout
 	VkDescriptorSetLayoutBinding layoutBinding;
 	layoutBinding = vkh::descriptorSetLayoutBinding(data_store::getDescriptorType(), VK_SHADER_STAGE_VERTEX_BIT, 0, 1);
@@ -90,7 +317,11 @@ void loadUBOTestMaterial(int num)
 	createInfo.outPipelineLayout = &appMaterial.pipelineLayout;
 
 	createInfo.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+#if QUANTIZED_VERTICES
+	createInfo.pushConstantRange = sizeof(QuantizedPushConstants);
+#else
 	createInfo.pushConstantRange = sizeof(uint32_t);
+#endif
 	createInfo.descSetLayouts.push_back(appMaterial.descSetLayout);
 
 #if WITH_COMPLEX_SHADER
@@ -136,10 +367,16 @@ void loadDebugMaterial()
 	createInfo.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
 	createInfo.pushConstantRange = sizeof(glm::mat4)*2;
 
+#if QUANTIZED_VERTICES
+	const char* vertShader = "..\\data\\_generated\\builtshaders\\common_vert_quantized.vert.spv";
+#else
+	const char* vertShader = "..\\data\\_generated\\builtshaders\\common_vert.vert.spv";
+#endif
+
 #if WITH_COMPLEX_SHADER
-	vkh::createBasicMaterial("..\\data\\_generated\\builtshaders\\common_vert.vert.spv", "..\\data\\_generated\\builtshaders\\random_frag.frag.spv", *appData.owningContext, createInfo);
+	vkh::createBasicMaterial(vertShader, "..\\data\\_generated\\builtshaders\\random_frag.frag.spv", *appData.owningContext, createInfo);
 #else
-	vkh::createBasicMaterial("..\\data\\_generated\\builtshaders\\common_vert.vert.spv", "..\\data\\_generated\\builtshaders\\debug_normals.frag.spv", *appData.owningContext, createInfo);
+	vkh::createBasicMaterial(vertShader, "..\\data\\_generated\\builtshaders\\debug_normals.frag.spv", *appData.owningContext, createInfo);
 #endif
 }
 
@@ -161,6 +398,7 @@ void createDepthBuffer()
 
 	vkh::AllocationCreateInfo createInfo;
 	createInfo.size = memRequirements.size;
+	createInfo.alignment = memRequirements.alignment;
 	createInfo.memoryTypeIndex = vkh::getMemoryType(ctxt.gpu.device, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	createInfo.usage = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
@@ -218,7 +456,19 @@ void render(Camera::Cam& cam, const std::vector<vkh::MeshAsset>& drawCalls, cons
 	glm::mat4 proj = vulkanCorrection * p;	
 	vkh::VkhContext& appContext = *appData.owningContext;
 
-#if !COPY_ON_MAIN_COMMANDBUFFER
+	//waits until the gpu is done with this frame slot, so its command buffer and upload regions are free to reuse
+	frame_pacer::FrameResources& frame = frame_pacer::beginFrame(appContext);
+	uint32_t frameIndex = frame_pacer::getFrameIndex();
+
+#if WITH_VK_TIMESTAMP
+	logGpuTime(frameIndex);
+#endif
+
+#if ASYNC_TRANSFER_QUEUE
+	VkCommandBuffer& transferCmd = vkh::beginAsyncTransfer(appData.asyncTransfer, appContext);
+	data_store::updateBuffers(view, proj, &transferCmd, appContext);
+	VkSemaphore uploadFinishedSemaphore = vkh::submitAsyncTransfer(appData.asyncTransfer, appContext);
+#elif !COPY_ON_MAIN_COMMANDBUFFER
 	data_store::updateBuffers(view, proj, nullptr, appContext);
 #endif
 
@@ -227,25 +477,31 @@ void render(Camera::Cam& cam, const std::vector<vkh::MeshAsset>& drawCalls, cons
 	//acquire an image from the swap chain
 	uint32_t imageIndex;
 
-	res = vkAcquireNextImageKHR(appContext.device, appContext.swapChain.swapChain, UINT64_MAX, appContext.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-	vkh::waitForFence(appContext.frameFences[imageIndex], appContext.device);
-	vkResetFences(appContext.device, 1, &appContext.frameFences[imageIndex]);
+	res = vkAcquireNextImageKHR(appContext.device, appContext.swapChain.swapChain, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
 
 	//record drawing
 	VkCommandBufferBeginInfo beginInfo = {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 	beginInfo.pInheritanceInfo = nullptr; // Optional
-	vkResetCommandBuffer(appData.commandBuffers[imageIndex], VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
-	res = vkBeginCommandBuffer(appData.commandBuffers[imageIndex], &beginInfo);
+	res = vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
+
+#if ASYNC_TRANSFER_QUEUE
+	vkh::acquireAsyncTransferTargets(appData.asyncTransfer, frame.commandBuffer);
+#endif
 
 #if COPY_ON_MAIN_COMMANDBUFFER
-	data_store::updateBuffers(view, proj, &appData.commandBuffers[imageIndex], appContext);
+	data_store::updateBuffers(view, proj, &frame.commandBuffer, appContext);
+#endif
+
+#if GPU_CULLING
+	gpu_culling::dispatch(view, proj, frame.commandBuffer, appContext);
 #endif
 
 
-	vkCmdResetQueryPool(appData.commandBuffers[imageIndex], appContext.queryPool, 0, 10);
-	vkCmdWriteTimestamp(appData.commandBuffers[imageIndex], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, appContext.queryPool, 0);
+	//each frame slot has its own pair of timestamps, read back once the slot's fence has signalled
+	vkCmdResetQueryPool(frame.commandBuffer, appContext.queryPool, frameIndex * 2, 2);
+	vkCmdWriteTimestamp(frame.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, appContext.queryPool, frameIndex * 2);
 
 
 	VkRenderPassBeginInfo renderPassInfo = {};
@@ -263,56 +519,67 @@ void render(Camera::Cam& cam, const std::vector<vkh::MeshAsset>& drawCalls, cons
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(2);
 	renderPassInfo.pClearValues = &clearColors[0];
 
-	vkCmdBeginRenderPass(appData.commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+#if CPU_FRUSTUM_CULLING
+	appData.drawList.resize(drawCalls.size());
+	uint32_t numDraws = frustum_culling::cull(proj * view, appData.drawList.data());
+#elif SORT_DRAWS
+	//the sort is stable and rewrites the whole list, so last frame's order is as good a start as any
+	if (appData.drawList.size() != drawCalls.size())
+	{
+		appData.drawList.resize(drawCalls.size());
+		for (uint32_t i = 0; i < drawCalls.size(); ++i) appData.drawList[i] = i;
+	}
+	uint32_t numDraws = static_cast<uint32_t>(appData.drawList.size());
+#else
+	uint32_t numDraws = static_cast<uint32_t>(drawCalls.size());
+#endif
+
+#if SORT_DRAWS
+	draw_sort::sort(view, appData.drawList.data(), numDraws);
+#endif
 
-	int currentlyBound = -1;
+#if CPU_FRUSTUM_CULLING || SORT_DRAWS
+	const uint32_t* drawOrder = appData.drawList.data();
+#else
+	const uint32_t* drawOrder = nullptr;
+#endif
 
-	vkCmdBindPipeline(appData.commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, appMaterial.graphicsPipeline);
+#if PARALLEL_RECORDING
+	vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-	for (uint32_t i = 0; i < drawCalls.size(); ++i)
-	{
-#if UBO_TEST || SSBO_TEST
-		glm::uint32 uboSlot = uboIdx[i] >> 3;
-		glm::uint32 uboPage = uboIdx[i] & 0x7;
+	double recordStart = OS::getMilliseconds();
 
-		currentlyBound = bindDescriptorSets(currentlyBound, uboPage, uboSlot, appData.commandBuffers[imageIndex]);
+	RecordJob job = { &drawCalls, &uboIdx, drawOrder, numDraws, view, proj, imageIndex, frameIndex, appData.activeWorkers };
+	thread_pool::parallelFor(job.numChunks, recordChunk, &job);
 
-		vkCmdPushConstants(
-			appData.commandBuffers[imageIndex],
-			appMaterial.pipelineLayout,
-			VK_SHADER_STAGE_VERTEX_BIT,
-			0,
-			sizeof(glm::uint32),
-			(void*)&uboSlot);
+	logRecordingTime(OS::getMilliseconds() - recordStart);
+	command_recorder::logStats(numDraws);
 
-#elif PUSH_TEST
-		
-		//0 is MVP, 1 is normal
-		glm::mat4 frameData[2];
+	vkCmdExecuteCommands(frame.commandBuffer, job.numChunks, &appData.workerCommandBuffers[frameIndex * RECORDING_THREADS]);
+#elif STATIC_COMMAND_BUFFERS
+	if (!appData.staticSceneRecorded)
+	{
+		recordStaticScene(drawCalls, uboIdx);
+	}
 
-		frameData[0] = vulkanCorrection * p * view;
-		frameData[1] = glm::transpose(glm::inverse(view));
+	vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	vkCmdExecuteCommands(frame.commandBuffer, 1, &appData.staticSceneCommandBuffer);
+#elif GPU_CULLING
+	vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		vkCmdPushConstants(
-			appData.commandBuffers[imageIndex],
-			appMaterial.pipelineLayout,
-			VK_SHADER_STAGE_VERTEX_BIT,
-			0,
-			sizeof(glm::mat4)*2,
-			(void*)&frameData);
-#endif
+	vkCmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, appMaterial.graphicsPipeline);
+	gpu_culling::draw(frame.commandBuffer, appMaterial.pipelineLayout, appMaterial.descSets.data());
+#else
+	vkCmdBeginRenderPass(frame.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		VkBuffer vertexBuffers[] = { drawCalls[i].buffer };
-		VkDeviceSize vertexOffsets[] = { 0 };
-		vkCmdBindVertexBuffers(appData.commandBuffers[imageIndex], 0, 1, vertexBuffers, vertexOffsets);
-		vkCmdBindIndexBuffer(appData.commandBuffers[imageIndex], drawCalls[i].buffer, drawCalls[i].iOffset, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(appData.commandBuffers[imageIndex], static_cast<uint32_t>(drawCalls[i].iCount), 1, 0, 0, 0);
-	}
+	recordDraws(frame.commandBuffer, drawCalls, uboIdx, drawOrder, 0, numDraws, view, proj);
+	command_recorder::logStats(numDraws);
+#endif
 
-	vkCmdEndRenderPass(appData.commandBuffers[imageIndex]);
-	vkCmdWriteTimestamp(appData.commandBuffers[imageIndex], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, appContext.queryPool, 1);
+	vkCmdEndRenderPass(frame.commandBuffer);
+	vkCmdWriteTimestamp(frame.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, appContext.queryPool, frameIndex * 2 + 1);
 
-	res = vkEndCommandBuffer(appData.commandBuffers[imageIndex]);
+	res = vkEndCommandBuffer(frame.commandBuffer);
 	checkf(res == VK_SUCCESS, "Error ending render pass");
 
 	// submit
@@ -320,21 +587,34 @@ void render(Camera::Cam& cam, const std::vector<vkh::MeshAsset>& drawCalls, cons
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	//wait on writing colours to the buffer until the semaphore says the buffer is available
-	VkSemaphore waitSemaphores[] = { appContext.imageAvailableSemaphore };
+#if ASYNC_TRANSFER_QUEUE
+	//the per object data has to be uploaded before any vertex shader reads it
+	VkSemaphore waitSemaphores[] = { frame.imageAvailable, uploadFinishedSemaphore };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT };
+	submitInfo.waitSemaphoreCount = 2;
+#else
+	VkSemaphore waitSemaphores[] = { frame.imageAvailable };
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 	submitInfo.waitSemaphoreCount = 1;
+#endif
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
 	submitInfo.commandBufferCount = 1;
 
-	VkSemaphore signalSemaphores[] = { appContext.renderFinishedSemaphore };
+#if ASYNC_TRANSFER_QUEUE
+	//present only waits on the first one, the second lets the next upload overwrite what this frame reads
+	VkSemaphore signalSemaphores[] = { frame.renderFinished, vkh::getAsyncTransferGraphicsSemaphore(appData.asyncTransfer) };
+	submitInfo.signalSemaphoreCount = 2;
+#else
+	VkSemaphore signalSemaphores[] = { frame.renderFinished };
 	submitInfo.signalSemaphoreCount = 1;
+#endif
 	submitInfo.pSignalSemaphores = signalSemaphores;
-	submitInfo.pCommandBuffers = &appData.commandBuffers[imageIndex];
+	submitInfo.pCommandBuffers = &frame.commandBuffer;
 	submitInfo.commandBufferCount = 1;
 
-	res = vkQueueSubmit(appContext.deviceQueues.graphicsQueue, 1, &submitInfo, appContext.frameFences[imageIndex]);
+	res = vkQueueSubmit(appContext.deviceQueues.graphicsQueue, 1, &submitInfo, frame.inFlight);
 	checkf(res == VK_SUCCESS, "Error submitting queue");
 
 	//present
@@ -350,47 +630,200 @@ void render(Camera::Cam& cam, const std::vector<vkh::MeshAsset>& drawCalls, cons
 	presentInfo.pSwapchains = swapChains;
 	presentInfo.pImageIndices = &imageIndex;
 	presentInfo.pResults = nullptr; // Optional
-	res = vkQueuePresentKHR(appContext.deviceQueues.transferQueue, &presentInfo);
+	res = vkQueuePresentKHR(appContext.deviceQueues.presentQueue, &presentInfo);
 
-#if WITH_VK_TIMESTAMP
-	//log performance data:
-
-	uint32_t end = 0;
-	uint32_t begin = 0;
+}
 
+#if WITH_VK_TIMESTAMP
+//called right after the frame slot's fence wait, so the timestamps it wrote last time around are already
+//available and reading them never stalls the cpu
+void logGpuTime(uint32_t frameIndex)
+{
+	static bool slotUsed[FRAMES_IN_FLIGHT] = {};
 	static int count = 0;
 	static float totalTime = 0.0f;
 
-	if (count++ > 1024)
+	vkh::VkhContext& appContext = *appData.owningContext;
+
+	if (!slotUsed[frameIndex])
+	{
+		slotUsed[frameIndex] = true;
+		return;
+	}
+
+	//64 bit results, 32 bit ones truncate the tick count. without the wait bit a slot that isn't ready
+	//returns VK_NOT_READY, and that frame is left out of the average rather than stalling
+	uint64_t timestamps[2] = { 0, 0 };
+	VkResult res = vkGetQueryPoolResults(appContext.device, appContext.queryPool, frameIndex * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (res != VK_SUCCESS)
+	{
+		return;
+	}
+
+	//timestampPeriod is nanoseconds per tick
+	uint64_t ticks = timestamps[1] - timestamps[0];
+	totalTime += static_cast<float>(ticks * appContext.gpu.deviceProps.limits.timestampPeriod / 1e6);
+
+	if (++count == 1024)
 	{
-		printf("VK Render Time (avg of past 1024 frames): %f ms\n", totalTime / 1024.0f);
+		printf("VK Render Time (avg of past 1024 frames, %s indices): %f ms\n", COMPACT_INDICES ? "16 / 32 bit" : "32 bit", totalTime / 1024.0f);
 		count = 0;
 		totalTime = 0;
 	}
-	float timestampFrequency = appContext.gpu.deviceProps.limits.timestampPeriod;
+}
+#endif
+
+int bindDescriptorSets(int currentlyBound, int page, int slot, command_recorder::Recorder& rec)
+{
+	uint32_t offsetCount = DYNAMIC_UBO;
+	uint32_t offset = offsetCount > 0 ? slot * appData.dynamicAlignment : 0;
+
+	//a dynamic ubo's offset selects the slot, so it has to be rebound whenever the slot changes, not just the page
+	if (currentlyBound != page || DYNAMIC_UBO)
+	{
+		command_recorder::bindDescriptorSet(rec, appMaterial.pipelineLayout, appMaterial.descSets[page], offsetCount, offset);
+	}
+	return page;
+}
 
+void recordDraws(VkCommandBuffer& cmd, const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& uboIdx, const uint32_t* drawOrder, uint32_t first, uint32_t last, const glm::mat4& view, const glm::mat4& proj)
+{
+	int currentlyBound = -1;
+	VkBuffer boundGeometry = VK_NULL_HANDLE;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+	command_recorder::Recorder rec;
+	command_recorder::begin(rec, cmd);
+	command_recorder::bindPipeline(rec, appMaterial.graphicsPipeline);
+
+	for (uint32_t i = first; i < last; ++i)
+	{
+		//drawOrder is the culled / sorted draw list, null draws everything in order
+		uint32_t d = drawOrder ? drawOrder[i] : i;
+
+#if UBO_TEST || SSBO_TEST
+		glm::uint32 uboSlot = uboIdx[d] >> STORE_PAGE_BITS;
+		glm::uint32 uboPage = uboIdx[d] & STORE_PAGE_MASK;
+
+		currentlyBound = bindDescriptorSets(currentlyBound, uboPage, uboSlot, rec);
+
+#if QUANTIZED_VERTICES
+		//16 bit positions are relative to the mesh bounds, the shader scales them back out
+		QuantizedPushConstants quantizedPush = { glm::vec4(drawCalls[d].min, 0.0f), glm::vec4(drawCalls[d].max - drawCalls[d].min, 0.0f), uboSlot };
+		command_recorder::pushConstants(rec, appMaterial.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(QuantizedPushConstants), &quantizedPush);
+#else
+		command_recorder::pushConstants(rec, appMaterial.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::uint32), &uboSlot);
+#endif
+
+#elif PUSH_TEST
+		
+		//0 is MVP, 1 is normal
+		glm::mat4 frameData[2];
+
+		frameData[0] = proj * view;
+#if QUANTIZED_VERTICES
+		//16 bit positions are relative to the mesh bounds, fold the scale back out into the mvp
+		frameData[0] = frameData[0] * glm::translate(drawCalls[d].min) * glm::scale(drawCalls[d].max - drawCalls[d].min);
+#endif
+		frameData[1] = glm::transpose(glm::inverse(view));
 
-	vkGetQueryPoolResults(appContext.device, appContext.queryPool, 1, 1, sizeof(uint32_t), &end, 0, VK_QUERY_RESULT_WAIT_BIT);
-	vkGetQueryPoolResults(appContext.device, appContext.queryPool, 0, 1, sizeof(uint32_t), &begin, 0, VK_QUERY_RESULT_WAIT_BIT);
-	uint32_t diff = end - begin;
-	totalTime += (diff) / (float)1e6;
+		command_recorder::pushConstants(rec, appMaterial.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4) * 2, &frameData);
 #endif
 
+		//arena meshes share their block's buffers, so only draws that cross into another block
+		//or switch index type rebind geometry
+		if (drawCalls[d].buffer != boundGeometry || drawCalls[d].indexType != boundIndexType)
+		{
+			command_recorder::bindVertexBuffer(rec, drawCalls[d].buffer, drawCalls[d].vOffset);
+			command_recorder::bindIndexBuffer(rec, drawCalls[d].indexBuffer, drawCalls[d].iOffset, drawCalls[d].indexType);
+			boundGeometry = drawCalls[d].buffer;
+			boundIndexType = drawCalls[d].indexType;
+		}
+		vkCmdDrawIndexed(cmd, static_cast<uint32_t>(drawCalls[d].iCount), 1, drawCalls[d].firstIndex, drawCalls[d].vertexOffset, 0);
+	}
+
+	command_recorder::end(rec);
 }
 
-int bindDescriptorSets(int currentlyBound, int page, int slot, VkCommandBuffer& cmd)
+#if PARALLEL_RECORDING
+void recordChunk(uint32_t chunk, void* data)
 {
+	RecordJob& job = *(RecordJob*)data;
 	vkh::VkhContext& appContext = *appData.owningContext;
 
-	size_t uboAlignment = appContext.gpu.deviceProps.limits.minUniformBufferOffsetAlignment;
-	size_t dynamicAlignment = ( (sizeof(VShaderInput) / uboAlignment) * uboAlignment)   + (( (sizeof(VShaderInput) % uboAlignment) > 0 ? uboAlignment : 0));
+	uint32_t workerSlot = job.frameIndex * RECORDING_THREADS + chunk;
+	VkCommandBuffer& cmd = appData.workerCommandBuffers[workerSlot];
 
-	uint32_t offsetCount = DYNAMIC_UBO;
-	uint32_t offset = offsetCount > 0 ? slot * dynamicAlignment :0;
+	//each pool is only ever touched by the one thread recording this chunk
+	vkResetCommandPool(appContext.device, appData.workerPools[workerSlot], 0);
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = appData.mainRenderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = appData.frameBuffers[job.imageIndex];
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	VkResult res = vkBeginCommandBuffer(cmd, &beginInfo);
+	checkf(res == VK_SUCCESS, "Error beginning secondary command buffer");
+
+	uint32_t first = (job.numDraws * chunk) / job.numChunks;
+	uint32_t last = (job.numDraws * (chunk + 1)) / job.numChunks;
+
+	recordDraws(cmd, *job.drawCalls, *job.uboIdx, job.drawOrder, first, last, job.view, job.proj);
+
+	res = vkEndCommandBuffer(cmd);
+	checkf(res == VK_SUCCESS, "Error ending secondary command buffer");
+}
+
+//averages recording time over RECORDING_FRAMES_PER_STEP frames, then steps to the next thread count
+void logRecordingTime(double ms)
+{
+	static uint32_t count = 0;
+	static double totalTime = 0.0;
 
-	if (currentlyBound != page)
+	totalTime += ms;
+	if (++count == RECORDING_FRAMES_PER_STEP)
 	{
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, appMaterial.pipelineLayout, 0, 1, &appMaterial.descSets[page], offsetCount, &offset);
+		const char* strategy = UBO_TEST ? (DYNAMIC_UBO ? "DYNAMIC_UBO" : "UBO_TEST") : (SSBO_TEST ? "SSBO_TEST" : "PUSH_TEST");
+		printf("CPU RECORD TIME (%s, %u threads, avg of past %u frames): %f ms\n", strategy, appData.activeWorkers, RECORDING_FRAMES_PER_STEP, totalTime / count);
+
+		appData.activeWorkers = (appData.activeWorkers % RECORDING_THREADS) + 1;
+		count = 0;
+		totalTime = 0.0;
 	}
-	return page;
-}
\ No newline at end of file
+}
+#endif
+
+#if STATIC_COMMAND_BUFFERS
+//draws only reference store pages and slots, never the camera, so they can be recorded once.
+//no framebuffer in the inheritance info lets the same secondary run inside every swapchain image's pass
+void recordStaticScene(const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& uboIdx)
+{
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = appData.mainRenderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	VkResult res = vkBeginCommandBuffer(appData.staticSceneCommandBuffer, &beginInfo);
+	checkf(res == VK_SUCCESS, "Error beginning static scene command buffer");
+
+	//view and proj are only read by PUSH_TEST, which can't use static command buffers
+	recordDraws(appData.staticSceneCommandBuffer, drawCalls, uboIdx, nullptr, 0, static_cast<uint32_t>(drawCalls.size()), glm::mat4(1.0f), glm::mat4(1.0f));
+
+	res = vkEndCommandBuffer(appData.staticSceneCommandBuffer);
+	checkf(res == VK_SUCCESS, "Error ending static scene command buffer");
+
+	appData.staticSceneRecorded = true;
+}
+#endif
\ No newline at end of file
@@ -11,5 +11,6 @@ struct DrawCall
 };
 
 void initRendering(vkh::VkhContext& context, uint32_t num);
+void shutdownRendering();
 void updateUBOs(Camera::Cam& cam);
 void render(Camera::Cam& camera, const std::vector<vkh::MeshAsset>& drawCalls, const std::vector<uint32_t>& uboIdx);
\ No newline at end of file
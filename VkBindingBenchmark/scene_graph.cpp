@@ -0,0 +1,107 @@
+#include "scene_graph.h"
+#include "debug.h"
+#include <glm/gtx/transform.hpp>
+#include <vector>
+
+namespace scene_graph
+{
+	std::vector<uint32_t> parents;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<uint8_t> dirty;
+
+	//animated nodes bob around their rest transform, each with its own phase
+	std::vector<uint32_t> animatedNodes;
+	std::vector<glm::mat4> restLocals;
+
+	std::vector<uint32_t> changedNodes;
+
+	void init(uint32_t capacity)
+	{
+		parents.reserve(capacity);
+		locals.reserve(capacity);
+		worlds.reserve(capacity);
+		dirty.reserve(capacity);
+		changedNodes.reserve(capacity);
+	}
+
+	uint32_t addNode(uint32_t parent, const glm::mat4& local, bool animated)
+	{
+		uint32_t node = static_cast<uint32_t>(parents.size());
+		checkf(parent == NO_PARENT || parent < node, "Scene graph parents must be added before their children");
+
+		parents.push_back(parent);
+		locals.push_back(local);
+		worlds.push_back(local);
+		dirty.push_back(1);
+
+		if (animated)
+		{
+			animatedNodes.push_back(node);
+			restLocals.push_back(local);
+		}
+
+		return node;
+	}
+
+	uint32_t getNumNodes()
+	{
+		return static_cast<uint32_t>(parents.size());
+	}
+
+	uint32_t getNumAnimatedNodes()
+	{
+		return static_cast<uint32_t>(animatedNodes.size());
+	}
+
+	void animate(float time)
+	{
+		for (uint32_t i = 0; i < animatedNodes.size(); ++i)
+		{
+			uint32_t node = animatedNodes[i];
+			float phase = time * 2.0f + i * 0.37f;
+
+			locals[node] = glm::translate(restLocals[i], glm::vec3(0.0f, sinf(phase) * 0.25f, 0.0f));
+			dirty[node] = 1;
+		}
+	}
+
+	void propagate()
+	{
+		changedNodes.clear();
+
+		//topological order means a parent's world matrix and dirty flag are final before any child reads them
+		const uint32_t numNodes = static_cast<uint32_t>(parents.size());
+		for (uint32_t i = 0; i < numNodes; ++i)
+		{
+			uint32_t parent = parents[i];
+			if (parent != NO_PARENT)
+			{
+				dirty[i] |= dirty[parent];
+			}
+
+			if (dirty[i])
+			{
+				worlds[i] = parent == NO_PARENT ? locals[i] : worlds[parent] * locals[i];
+				changedNodes.push_back(i);
+			}
+		}
+
+		//flags are cleared afterwards, children later in the arrays read their parent's flag during the pass
+		for (uint32_t i = 0; i < changedNodes.size(); ++i)
+		{
+			dirty[changedNodes[i]] = 0;
+		}
+	}
+
+	const uint32_t* getChangedNodes(uint32_t& outCount)
+	{
+		outCount = static_cast<uint32_t>(changedNodes.size());
+		return changedNodes.data();
+	}
+
+	const glm::mat4& getWorld(uint32_t node)
+	{
+		return worlds[node];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+//Flat transform hierarchy. Nodes live in parallel arrays in topological order (a parent is always
+//added before its children) so world matrices are propagated in one front to back pass
+namespace scene_graph
+{
+	static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+	void init(uint32_t capacity);
+
+	//parent must already be in the graph, or NO_PARENT for a root
+	uint32_t addNode(uint32_t parent, const glm::mat4& local, bool animated);
+	uint32_t getNumNodes();
+	uint32_t getNumAnimatedNodes();
+
+	//moves the animated nodes' local transforms, time is in seconds
+	void animate(float time);
+
+	//recomputes world matrices for every node whose local transform or parent changed
+	void propagate();
+
+	//nodes whose world matrix changed during the last propagate()
+	const uint32_t* getChangedNodes(uint32_t& outCount);
+	const glm::mat4& getWorld(uint32_t node);
+}
\ No newline at end of file
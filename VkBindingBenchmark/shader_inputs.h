@@ -7,3 +7,15 @@ struct VShaderInput
 	glm::mat4 model;
 	glm::mat4 normal;
 };
+
+//push constants for the _quantized ubo / ssbo vertex shaders, positions are scaled back out to the mesh bounds
+struct QuantizedPushConstants
+{
+	glm::vec4 posOffset;
+	glm::vec4 posScale;
+	glm::uint32 tform;
+};
+
+//data store indices are (slot << STORE_PAGE_BITS) | page
+#define STORE_PAGE_BITS 8
+#define STORE_PAGE_MASK ((1u << STORE_PAGE_BITS) - 1)
\ No newline at end of file
@@ -2,6 +2,10 @@
 #include <glm/gtx/transform.hpp>
 #include <deque>
 #include "shader_inputs.h"
+#include "transform_compute.h"
+#include "mapped_writer.h"
+#include "frame_pacer.h"
+#include "frame_allocator.h"
 #include "config.h"
 namespace ssbo_store
 {
@@ -18,22 +22,65 @@ namespace ssbo_store
 	vkh::Allocation alloc;
 	std::deque<uint32_t> freeIndices;
 
+#if SCENE_GRAPH && !COMPUTE_TRANSFORMS
+	std::vector<glm::mat4> models;
+#endif
+
 #if PERSISTENT_STAGING_BUFFER
 	VkBuffer stagingBuffer;
 	vkh::Allocation stagingAlloc;
+
+	//each frame in flight gets its own region of the staging buffer, rounded up so each region can be flushed on its own
+	uint32_t stagingRegionSize;
 #endif
 
-	void init(vkh::VkhContext& _ctxt)
+#if DIRECT_TO_VRAM
+	bool directWrite;
+
+	//the whole ssbo goes in the host visible vram heap if it fits, otherwise we fall back to the staged path
+	bool createDirectWriteBuffer(vkh::VkhContext& _ctxt)
 	{
-		ctxt = &_ctxt;
+		uint32_t memoryType;
+		VkDeviceSize heapSize;
+		VkDeviceSize bufferSize = sizeof(VShaderInput) * num;
 
-#if BISTRO_TEST
-		num = 25000;
-#else
-		num = 511;
+		uint32_t memoryTypeBits = vkh::getBufferMemoryTypeBits(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, _ctxt);
+		if (!vkh::getHostVisibleDeviceMemoryType(memoryType, heapSize, memoryTypeBits, _ctxt.gpu.device))
+		{
+			printf("No host visible device local memory, SSBO will be staged\n");
+			return false;
+		}
+
+		printf("Host visible device local memory type %u, heap size: %llu MB\n", memoryType, (unsigned long long)(heapSize >> 20));
+
+		if (vkh::getHeapAllocatedSize(memoryType, _ctxt) + bufferSize > heapSize)
+		{
+			printf("SSBO does not fit in the host visible device local heap, it will be staged\n");
+			return false;
+		}
+
+		vkh::createBuffer(
+			buf,
+			alloc,
+			bufferSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			_ctxt);
+
+		map = (char*)alloc.map;
+
+		return true;
+	}
 #endif
 
+	void createStagedBuffer(vkh::VkhContext& _ctxt)
+	{
+#if ASYNC_TRANSFER_QUEUE
+		//only the graphics queue reads the buffer, the transfer queue hands it over after every copy
+		vkh::createExclusiveBuffer(
+#else
 		vkh::createBuffer(
+#endif
 			buf, 
 			alloc, 
 			sizeof(VShaderInput) * num, 
@@ -47,10 +94,13 @@ namespace ssbo_store
 			_ctxt);
 
 #if PERSISTENT_STAGING_BUFFER
+		size_t atomSize = _ctxt.gpu.deviceProps.limits.nonCoherentAtomSize;
+		stagingRegionSize = static_cast<uint32_t>(((sizeof(VShaderInput) * num + atomSize - 1) / atomSize) * atomSize);
+
 		vkh::createBuffer(
 			stagingBuffer,
 			stagingAlloc,
-			sizeof(VShaderInput) * num,
+			stagingRegionSize * FRAMES_IN_FLIGHT,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 #if COPY_ON_MAIN_COMMANDBUFFER
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
@@ -62,20 +112,49 @@ namespace ssbo_store
 
 #if DEVICE_LOCAL
 #if PERSISTENT_STAGING_BUFFER
-		vkMapMemory(_ctxt.device, stagingAlloc.handle, stagingAlloc.offset, stagingAlloc.size, 0, &map);
+		map = stagingAlloc.map;
 #else
 		map = (char*)malloc(sizeof(VShaderInput) * num);
 #endif
 #else
-		vkMapMemory(_ctxt.device, alloc.handle, alloc.offset, alloc.size, 0, &map);
+		map = alloc.map;
 #endif
+	}
 
+	void init(vkh::VkhContext& _ctxt)
+	{
+		ctxt = &_ctxt;
+
+#if BISTRO_TEST
+		num = 25000;
+#else
+		num = 511;
+#endif
+
+#if DIRECT_TO_VRAM
+		directWrite = createDirectWriteBuffer(_ctxt);
+		if (!directWrite)
+		{
+			createStagedBuffer(_ctxt);
+		}
+#else
+		createStagedBuffer(_ctxt);
+#endif
 
 		for (uint32_t i = 0; i < num; ++i)
 		{
 			freeIndices.push_back(i);
 		}
 
+#if SCENE_GRAPH && !COMPUTE_TRANSFORMS
+		models.resize(num, glm::mat4(1.0f));
+#endif
+
+#if COMPUTE_TRANSFORMS
+		transform_compute::init(_ctxt);
+		transform_compute::addTarget(buf, num, sizeof(VShaderInput));
+#endif
+
 	}
 
 	bool acquire(uint32_t& outIdx)
@@ -90,8 +169,8 @@ namespace ssbo_store
 		freeIndices.pop_front();
 
 		//we may have to page this at some point, reserve
-		//3 bits for page id. 
-		outIdx = outIdx << 3;
+		//bits for page id. 
+		outIdx = outIdx << STORE_PAGE_BITS;
 
 		return true;
 
@@ -107,25 +186,95 @@ namespace ssbo_store
 		return buf;
 	}
 
+	//whether updateBuffers fills the buffer with a copy, rather than writing it through a mapping
+	bool isCopyTarget(uint32_t idx)
+	{
+#if DIRECT_TO_VRAM
+		return DEVICE_LOCAL && !directWrite;
+#else
+		return DEVICE_LOCAL;
+#endif
+	}
+
 	vkh::Allocation& getAlloc(uint32_t idx)
 	{
 		return alloc;
 	}
 
+	void setModelMatrix(uint32_t idx, const glm::mat4& model)
+	{
+		uint32_t slot = idx >> STORE_PAGE_BITS;
+
+#if COMPUTE_TRANSFORMS
+		transform_compute::setModel(slot, model);
+#elif SCENE_GRAPH
+		models[slot] = model;
+#endif
+	}
+
 	void updateBuffers(const glm::mat4& viewMatrix, const glm::mat4& projMatrix, VkCommandBuffer* commandBuffer, vkh::VkhContext& ctxt)
 	{
+#if COMPUTE_TRANSFORMS
+		transform_compute::dispatch(viewMatrix, projMatrix, *commandBuffer, ctxt);
+#else
+#if DIRECT_TO_VRAM
+		//write combined memory: whole structs written front to back, never read from the mapping
+		if (directWrite)
+		{
+			VShaderInput* directPtr = (VShaderInput*)map;
+			for (uint32_t i = 0; i < num; ++i)
+			{
+#if SCENE_GRAPH
+				const glm::mat4 modelView = viewMatrix * models[i];
+#else
+				const glm::mat4& modelView = viewMatrix;
+#endif
+				VShaderInput slotInput = { projMatrix * modelView, glm::transpose(glm::inverse(modelView)) };
+#if STREAMING_STORES
+				mapped_writer::streamCopy(&directPtr[i], &slotInput, sizeof(VShaderInput));
+#else
+				memcpy(&directPtr[i], &slotInput, sizeof(VShaderInput));
+#endif
+			}
+#if STREAMING_STORES
+			mapped_writer::streamFence();
+#endif
+			return;
+		}
+#endif
+
+#if PERSISTENT_STAGING_BUFFER
+		const uint32_t frameOffset = frame_pacer::getFrameIndex() * stagingRegionSize;
+		VShaderInput* objPtr = (VShaderInput*)((char*)map + frameOffset);
+#else
 		VShaderInput* objPtr = (VShaderInput*)map;
+#endif
 
 		for (uint32_t i = 0; i < num; ++i)
 		{
-			objPtr[i].model = projMatrix * viewMatrix;
-			objPtr[i].normal = glm::transpose(glm::inverse(viewMatrix));
+#if SCENE_GRAPH
+			const glm::mat4 modelView = viewMatrix * models[i];
+#else
+			const glm::mat4& modelView = viewMatrix;
+#endif
+
+#if STREAMING_STORES
+			VShaderInput slotInput = { projMatrix * modelView, glm::transpose(glm::inverse(modelView)) };
+			mapped_writer::streamCopy(&objPtr[i], &slotInput, sizeof(VShaderInput));
+#else
+			objPtr[i].model = projMatrix * modelView;
+			objPtr[i].normal = glm::transpose(glm::inverse(modelView));
+#endif
 		}
 
+#if STREAMING_STORES
+		mapped_writer::streamFence();
+#endif
+
 		VkMappedMemoryRange range;
 		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 #if PERSISTENT_STAGING_BUFFER
-		range.offset = stagingAlloc.offset;
+		range.offset = stagingAlloc.offset + frameOffset;
 		range.memory = stagingAlloc.handle;
 #else
 		range.offset = alloc.offset;
@@ -134,19 +283,52 @@ namespace ssbo_store
 		range.pNext = nullptr;
 		range.size = num * sizeof(VShaderInput);
 
+#if PERSISTENT_STAGING_BUFFER
+		//the flush has to cover whole atoms, the copy below only needs the live part
+		range.size = stagingRegionSize;
+#endif
+
 
 		#if PERSISTENT_STAGING_BUFFER || !DEVICE_LOCAL
 				vkFlushMappedMemoryRanges(ctxt.device, 1, &range);	
 		#endif
 
 		#if DEVICE_LOCAL
+			#if COPY_ON_MAIN_COMMANDBUFFER
+				//every frame in flight copies into the same buffer, last frame's vertex shaders have to be done reading it first
+				vkCmdPipelineBarrier(*commandBuffer,
+					VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					0, 0, nullptr, 0, nullptr, 0, nullptr);
+			#endif
+
 			#if PERSISTENT_STAGING_BUFFER		
-				vkh::copyBuffer(stagingBuffer, buf, range.size, 0, 0, commandBuffer, ctxt);
+				vkh::copyBuffer(stagingBuffer, buf, num * sizeof(VShaderInput), frameOffset, 0, commandBuffer, ctxt);
+			#elif FRAME_UPLOAD_RING
+				frame_allocator::uploadToBuffer(buf, 0, map, range.size, commandBuffer, ctxt);
 			#else		
 				vkh::copyDataToBuffer(&buf, range.size, 0, (char*)map, ctxt);	
 			#endif	
+
+			#if COPY_ON_MAIN_COMMANDBUFFER
+				//and this frame's draws have to wait for the copy to land
+				VkBufferMemoryBarrier uploadBarrier = {};
+				uploadBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+				uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				uploadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				uploadBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				uploadBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				uploadBarrier.buffer = buf;
+				uploadBarrier.offset = 0;
+				uploadBarrier.size = num * sizeof(VShaderInput);
+
+				vkCmdPipelineBarrier(*commandBuffer,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+					0, 0, nullptr, 1, &uploadBarrier, 0, nullptr);
+			#endif
 		#endif
-		
+#endif
 	}
 
 	VkDescriptorType getDescriptorType()
@@ -12,7 +12,9 @@ namespace ssbo_store
 	bool acquire(uint32_t& outIdx);
 	uint32_t getNumPages();
 	VkBuffer& getPage(uint32_t idx);
+	bool isCopyTarget(uint32_t idx);
 	vkh::Allocation& getAlloc(uint32_t idx);
+	void setModelMatrix(uint32_t idx, const glm::mat4& model);
 	void updateBuffers(const glm::mat4& viewMatrix, const glm::mat4& projMatrix, VkCommandBuffer* commandBuffer, vkh::VkhContext& ctxt);
 	VkDescriptorType getDescriptorType();
 }
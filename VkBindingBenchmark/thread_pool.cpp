@@ -0,0 +1,114 @@
+#include "thread_pool.h"
+#include "debug.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace thread_pool
+{
+	struct Job
+	{
+		TaskFn fn;
+		void* data;
+		uint32_t numTasks;
+	};
+
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+
+	//tasks are handed out under the lock, parallelFor is meant for a handful of large tasks, not thousands of tiny ones
+	Job job;
+	uint32_t nextTask;
+	uint32_t tasksDone;
+	bool exiting;
+
+	//claims and runs tasks until the job has none left, lock must be held on entry and is held on return
+	void runTasks(std::unique_lock<std::mutex>& heldLock)
+	{
+		while (nextTask < job.numTasks)
+		{
+			uint32_t taskIdx = nextTask++;
+			Job current = job;
+
+			heldLock.unlock();
+			current.fn(taskIdx, current.data);
+			heldLock.lock();
+
+			if (++tasksDone == current.numTasks)
+			{
+				doneCondition.notify_one();
+			}
+		}
+	}
+
+	void workerMain()
+	{
+		std::unique_lock<std::mutex> heldLock(lock);
+
+		while (true)
+		{
+			wakeCondition.wait(heldLock, [] { return exiting || nextTask < job.numTasks; });
+			if (exiting) return;
+
+			runTasks(heldLock);
+		}
+	}
+
+	void init(uint32_t numWorkers)
+	{
+		checkf(workers.size() == 0, "Thread pool initialized twice");
+
+		job = {};
+		nextTask = 0;
+		tasksDone = 0;
+		exiting = false;
+
+		for (uint32_t i = 0; i < numWorkers; ++i)
+		{
+			workers.push_back(std::thread(workerMain));
+		}
+	}
+
+	uint32_t getNumWorkers()
+	{
+		return static_cast<uint32_t>(workers.size());
+	}
+
+	void parallelFor(uint32_t numTasks, TaskFn fn, void* data)
+	{
+		std::unique_lock<std::mutex> heldLock(lock);
+
+		job.fn = fn;
+		job.data = data;
+		job.numTasks = numTasks;
+		nextTask = 0;
+		tasksDone = 0;
+
+		wakeCondition.notify_all();
+
+		runTasks(heldLock);
+		doneCondition.wait(heldLock, [] { return tasksDone == job.numTasks; });
+
+		//nothing left to claim, keeps late waking workers asleep
+		job.numTasks = 0;
+		nextTask = 0;
+	}
+
+	void shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> heldLock(lock);
+			exiting = true;
+		}
+		wakeCondition.notify_all();
+
+		for (uint32_t i = 0; i < workers.size(); ++i)
+		{
+			workers[i].join();
+		}
+		workers.clear();
+	}
+}
\ No newline at end of file
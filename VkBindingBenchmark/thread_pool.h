@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+
+//Small fixed size worker pool. The calling thread works alongside the workers,
+//so init(n) gives parallelFor n + 1 threads of parallelism
+namespace thread_pool
+{
+	typedef void(*TaskFn)(uint32_t taskIdx, void* data);
+
+	void init(uint32_t numWorkers);
+	uint32_t getNumWorkers();
+
+	//runs fn for every task in [0, numTasks) and returns once they have all finished
+	void parallelFor(uint32_t numTasks, TaskFn fn, void* data);
+
+	void shutdown();
+}
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "transform_compute.h"
+#include "vkh_material.h"
+#include "vkh_initializers.h"
+#include "config.h"
+#include "frame_pacer.h"
+#include <vector>
+
+#define EXPAND_SHADER_NAME "..\\data\\_generated\\builtshaders\\expand_transforms.comp.spv"
+#define EXPAND_GROUP_SIZE 64
+
+namespace transform_compute
+{
+	struct FrameData
+	{
+		glm::mat4 view;
+		glm::mat4 proj;
+	};
+
+	struct ExpandPushConstants
+	{
+		uint32_t firstModel;
+		uint32_t count;
+		uint32_t strideVec4;
+	};
+
+	struct ExpandTarget
+	{
+		VkBuffer buf;
+		uint32_t firstModel;
+		uint32_t count;
+		uint32_t stride;
+		VkDescriptorSet descSet;
+	};
+
+	vkh::VkhContext* ctxt;
+
+	std::vector<ExpandTarget> targets;
+	std::vector<glm::mat4> models;
+	std::vector<uint32_t> dirtyModels;
+	std::vector<uint8_t> isDirty;
+	std::vector<VkBufferCopy> copyRegions;
+
+	bool buffersCreated;
+
+	//models are written here on the CPU, and only the dirty ones are copied to modelBuf each frame.
+	//one region of models.size() matrices per frame in flight, so a frame never overwrites one still being copied
+	VkBuffer stagingBuf;
+	vkh::Allocation stagingAlloc;
+	glm::mat4* stagingMap;
+
+	VkBuffer modelBuf;
+	vkh::Allocation modelAlloc;
+
+	VkBuffer frameBuf;
+	vkh::Allocation frameAlloc;
+
+	VkDescriptorSetLayout descSetLayout;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+
+	void init(vkh::VkhContext& _ctxt)
+	{
+		ctxt = &_ctxt;
+
+		VkDescriptorSetLayoutBinding layoutBindings[3];
+		layoutBindings[0] = vkh::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0, 1);
+		layoutBindings[1] = vkh::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1, 1);
+		layoutBindings[2] = vkh::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2, 1);
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = vkh::descriptorSetLayoutCreateInfo(&layoutBindings[0], 3);
+		VkResult res = vkCreateDescriptorSetLayout(_ctxt.device, &layoutInfo, nullptr, &descSetLayout);
+		checkf(res == VK_SUCCESS, "Error creating transform expansion desc set layout");
+
+		vkh::VkhMaterialCreateInfo createInfo = {};
+		createInfo.outPipeline = &pipeline;
+		createInfo.outPipelineLayout = &pipelineLayout;
+		createInfo.pushConstantStages = VK_SHADER_STAGE_COMPUTE_BIT;
+		createInfo.pushConstantRange = sizeof(ExpandPushConstants);
+		createInfo.descSetLayouts.push_back(descSetLayout);
+
+		vkh::createComputeMaterial(EXPAND_SHADER_NAME, _ctxt, createInfo);
+	}
+
+	uint32_t addTarget(VkBuffer& buffer, uint32_t count, uint32_t stride)
+	{
+		checkf(!buffersCreated, "Attempting to add a transform expansion target after the first dispatch");
+		checkf(stride % sizeof(glm::vec4) == 0, "Transform expansion stride must be a multiple of 16 bytes");
+
+		ExpandTarget target = {};
+		target.buf = buffer;
+		target.firstModel = static_cast<uint32_t>(models.size());
+		target.count = count;
+		target.stride = stride;
+		targets.push_back(target);
+
+		models.resize(models.size() + count, glm::mat4(1.0f));
+		isDirty.resize(models.size(), 0);
+
+		return target.firstModel;
+	}
+
+	void setModel(uint32_t modelIdx, const glm::mat4& model)
+	{
+		models[modelIdx] = model;
+
+		if (!isDirty[modelIdx])
+		{
+			isDirty[modelIdx] = 1;
+			dirtyModels.push_back(modelIdx);
+		}
+	}
+
+	void createBuffers()
+	{
+		vkh::VkhContext& _ctxt = *ctxt;
+		VkDeviceSize modelSize = sizeof(glm::mat4) * models.size();
+
+		vkh::createBuffer(stagingBuf,
+			stagingAlloc,
+			modelSize * FRAMES_IN_FLIGHT,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			_ctxt);
+
+		stagingMap = (glm::mat4*)stagingAlloc.map;
+
+		vkh::createBuffer(modelBuf,
+			modelAlloc,
+			modelSize,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			_ctxt);
+
+		vkh::createBuffer(frameBuf,
+			frameAlloc,
+			sizeof(FrameData),
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			_ctxt);
+
+		for (uint32_t t = 0; t < targets.size(); ++t)
+		{
+			VkDescriptorSetAllocateInfo allocInfo = vkh::descriptorSetAllocateInfo(&descSetLayout, 1, _ctxt.descriptorPool);
+			VkResult res = vkAllocateDescriptorSets(_ctxt.device, &allocInfo, &targets[t].descSet);
+			checkf(res == VK_SUCCESS, "Error allocating transform expansion descriptor set");
+
+			VkDescriptorBufferInfo bufferInfos[3];
+			bufferInfos[0] = { frameBuf, 0, VK_WHOLE_SIZE };
+			bufferInfos[1] = { modelBuf, 0, VK_WHOLE_SIZE };
+			bufferInfos[2] = { targets[t].buf, 0, VK_WHOLE_SIZE };
+
+			VkWriteDescriptorSet setWrites[3];
+			for (uint32_t b = 0; b < 3; ++b)
+			{
+				setWrites[b] = {};
+				setWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				setWrites[b].dstSet = targets[t].descSet;
+				setWrites[b].dstBinding = b;
+				setWrites[b].dstArrayElement = 0;
+				setWrites[b].descriptorType = b == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				setWrites[b].descriptorCount = 1;
+				setWrites[b].pBufferInfo = &bufferInfos[b];
+			}
+
+			vkUpdateDescriptorSets(_ctxt.device, 3, &setWrites[0], 0, nullptr);
+		}
+
+		//everything needs uploading on the first frame
+		dirtyModels.clear();
+		for (uint32_t i = 0; i < models.size(); ++i)
+		{
+			isDirty[i] = 1;
+			dirtyModels.push_back(i);
+		}
+
+		copyRegions.reserve(models.size());
+		buffersCreated = true;
+	}
+
+	void dispatch(const glm::mat4& viewMatrix, const glm::mat4& projMatrix, VkCommandBuffer& commandBuffer, vkh::VkhContext& ctxt)
+	{
+		if (!buffersCreated)
+		{
+			createBuffers();
+		}
+
+		//frameBuf and modelBuf are shared by every frame in flight, the previous frame's expansion has to be done
+		//reading them before they're written again. a write after read only needs an execution dependency
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		FrameData frameData = { viewMatrix, projMatrix };
+		vkCmdUpdateBuffer(commandBuffer, frameBuf, 0, sizeof(FrameData), &frameData);
+
+		const uint32_t frameFirstModel = frame_pacer::getFrameIndex() * static_cast<uint32_t>(models.size());
+
+		copyRegions.clear();
+		for (uint32_t i = 0; i < dirtyModels.size(); ++i)
+		{
+			uint32_t idx = dirtyModels[i];
+			stagingMap[frameFirstModel + idx] = models[idx];
+			isDirty[idx] = 0;
+
+			VkBufferCopy region = {};
+			region.srcOffset = (frameFirstModel + idx) * sizeof(glm::mat4);
+			region.dstOffset = idx * sizeof(glm::mat4);
+			region.size = sizeof(glm::mat4);
+			copyRegions.push_back(region);
+		}
+		dirtyModels.clear();
+
+		if (copyRegions.size() > 0)
+		{
+			vkCmdCopyBuffer(commandBuffer, stagingBuf, modelBuf, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+		}
+
+		//the uploads need to land before the expansion reads them, and last frame's vertex shaders
+		//need to be done reading the store pages before we overwrite them
+		VkMemoryBarrier uploadBarrier = {};
+		uploadBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		uploadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+		for (uint32_t t = 0; t < targets.size(); ++t)
+		{
+			const ExpandTarget& target = targets[t];
+			ExpandPushConstants pc = { target.firstModel, target.count, target.stride / static_cast<uint32_t>(sizeof(glm::vec4)) };
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &target.descSet, 0, nullptr);
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ExpandPushConstants), &pc);
+			vkCmdDispatch(commandBuffer, (target.count + EXPAND_GROUP_SIZE - 1) / EXPAND_GROUP_SIZE, 1, 1);
+		}
+
+		VkMemoryBarrier expandBarrier = {};
+		expandBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		expandBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		expandBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			0, 1, &expandBarrier, 0, nullptr, 0, nullptr);
+	}
+}
\ No newline at end of file
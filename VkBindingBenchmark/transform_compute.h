@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "vkh.h"
+
+//Expands compact per-object model matrices into the data store's pages with a compute shader,
+//so the CPU only uploads the model matrices that changed and never builds MVP / normal matrices itself
+namespace transform_compute
+{
+	void init(vkh::VkhContext& ctxt);
+
+	//registers a store page to expand into, returns the index of the page's first model matrix
+	uint32_t addTarget(VkBuffer& buffer, uint32_t count, uint32_t stride);
+	void setModel(uint32_t modelIdx, const glm::mat4& model);
+
+	//records the dirty model uploads and the expansion dispatches, must be called outside of a render pass
+	void dispatch(const glm::mat4& viewMatrix, const glm::mat4& projMatrix, VkCommandBuffer& commandBuffer, vkh::VkhContext& ctxt);
+}
\ No newline at end of file
@@ -4,6 +4,10 @@
 #include <deque>
 #include <glm/gtx/transform.hpp>
 #include "shader_inputs.h"
+#include "transform_compute.h"
+#include "mapped_writer.h"
+#include "frame_pacer.h"
+#include "frame_allocator.h"
 
 namespace ubo_store
 {
@@ -16,6 +20,11 @@ namespace ubo_store
 	//so each slot may need to be slightly larger than the size of VShaderInput
 	uint32_t slotSize;
 
+#if PERSISTENT_STAGING_BUFFER
+	//each frame in flight gets its own region of every page's staging buffer, rounded up so each region can be flushed on its own
+	uint32_t stagingRegionSize;
+#endif
+
 	vkh::VkhContext* ctxt;
 
 	struct UBOPage
@@ -24,6 +33,12 @@ namespace ubo_store
 		vkh::Allocation alloc;
 		std::deque<uint32_t> freeIndices;
 
+#if COMPUTE_TRANSFORMS
+		uint32_t firstModel;
+#elif SCENE_GRAPH
+		std::vector<glm::mat4> models;
+#endif
+
 #if DEVICE_LOCAL
 #if PERSISTENT_STAGING_BUFFER
 		void* map;
@@ -39,10 +54,20 @@ namespace ubo_store
 		VkBuffer stagingBuf;
 		vkh::Allocation stagingAlloc;
 #endif
+
+#if DIRECT_TO_VRAM
+		bool directWrite;
+#endif
 	};
 
 	std::vector<UBOPage> pages;
 
+#if DIRECT_TO_VRAM
+	bool hasDirectMemory;
+	uint32_t directMemoryType;
+	VkDeviceSize directHeapSize;
+#endif
+
 	void init(vkh::VkhContext& _ctxt)
 	{		
 		ctxt = &_ctxt;
@@ -59,22 +84,71 @@ namespace ubo_store
 		countPerPage = 256;
 		size = (sizeof(VShaderInput) * countPerPage);
 #endif
+
+#if PERSISTENT_STAGING_BUFFER
+		size_t atomSize = _ctxt.gpu.deviceProps.limits.nonCoherentAtomSize;
+		stagingRegionSize = static_cast<uint32_t>(((size + atomSize - 1) / atomSize) * atomSize);
+#endif
+
+#if COMPUTE_TRANSFORMS
+		transform_compute::init(_ctxt);
+#endif
+
+#if DIRECT_TO_VRAM
+		uint32_t memoryTypeBits = vkh::getBufferMemoryTypeBits(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, _ctxt);
+		hasDirectMemory = vkh::getHostVisibleDeviceMemoryType(directMemoryType, directHeapSize, memoryTypeBits, _ctxt.gpu.device);
+		if (hasDirectMemory)
+		{
+			printf("Writing UBO pages directly to VRAM, memory type %u, heap size: %llu MB\n", directMemoryType, (unsigned long long)(directHeapSize >> 20));
+		}
+		else
+		{
+			printf("No host visible device local memory, UBO pages will be staged\n");
+		}
+#endif
 	}
 
-	UBOPage& createNewPage()
+#if DIRECT_TO_VRAM
+	//pages only go in the host visible vram heap while it has room, the rest fall back to the staged path
+	bool hasDirectWriteSpace(VkDeviceSize bytes)
+	{
+		return hasDirectMemory && (vkh::getHeapAllocatedSize(directMemoryType, *ctxt) + bytes <= directHeapSize);
+	}
+
+	void createDirectWritePage(UBOPage& page)
+	{
+		vkh::VkhContext& _ctxt = *ctxt;
+
+		vkh::createBuffer(
+			page.buf,
+			page.alloc,
+			size,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			_ctxt);
+
+		page.map = (char*)page.alloc.map;
+	}
+#endif
+
+	void createStagedPage(UBOPage& page)
 	{
-		UBOPage page;
 		vkh::VkhContext& _ctxt = *ctxt;
 
+#if ASYNC_TRANSFER_QUEUE
+		//only the graphics queue reads the page, the transfer queue hands it over after every copy
+		vkh::createExclusiveBuffer(
+#else
 		vkh::createBuffer(
+#endif
 			page.buf,
 			page.alloc,
 			size,
 #if DEVICE_LOCAL
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | (COMPUTE_TRANSFORMS ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0),
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 #else
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | (COMPUTE_TRANSFORMS ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0),
 			VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
 #endif
 			_ctxt);
@@ -83,7 +157,7 @@ namespace ubo_store
 		vkh::createBuffer(
 			page.stagingBuf,
 			page.stagingAlloc,
-			size,
+			stagingRegionSize * FRAMES_IN_FLIGHT,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 #if COPY_ON_MAIN_COMMANDBUFFER
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
@@ -96,12 +170,37 @@ namespace ubo_store
 
 #if DEVICE_LOCAL
 #if PERSISTENT_STAGING_BUFFER
-		vkMapMemory(_ctxt.device, page.stagingAlloc.handle, page.stagingAlloc.offset, page.stagingAlloc.size, 0, &page.map);
+		page.map = page.stagingAlloc.map;
 #else
 		page.map = (char*)malloc(size);
 #endif
 #else
-		vkMapMemory(_ctxt.device, page.alloc.handle, page.alloc.offset, page.alloc.size, 0, &page.map);
+		page.map = page.alloc.map;
+#endif
+	}
+
+	UBOPage& createNewPage()
+	{
+		UBOPage page;
+
+#if DIRECT_TO_VRAM
+		page.directWrite = hasDirectWriteSpace(size);
+		if (page.directWrite)
+		{
+			createDirectWritePage(page);
+		}
+		else
+		{
+			createStagedPage(page);
+		}
+#else
+		createStagedPage(page);
+#endif
+
+#if COMPUTE_TRANSFORMS
+		page.firstModel = transform_compute::addTarget(page.buf, countPerPage, DYNAMIC_UBO ? slotSize : sizeof(VShaderInput));
+#elif SCENE_GRAPH
+		page.models.resize(countPerPage, glm::mat4(1.0f));
 #endif
 
 		for (uint32_t i = 0; i < countPerPage; ++i)
@@ -125,6 +224,16 @@ namespace ubo_store
 		return pages[idx].buf;
 	}
 
+	//whether updateBuffers fills the page with a copy, rather than writing it through a mapping
+	bool isCopyTarget(uint32_t idx)
+	{
+#if DIRECT_TO_VRAM
+		return DEVICE_LOCAL && !pages[idx].directWrite;
+#else
+		return DEVICE_LOCAL;
+#endif
+	}
+
 	bool acquire(uint32_t& outIdx)
 	{
 		UBOPage* p = nullptr;
@@ -143,11 +252,13 @@ namespace ubo_store
 			p = &createNewPage();
 		}
 		
+		uint32_t pageIdx = static_cast<uint32_t>(p - pages.data());
+		checkf(pageIdx <= STORE_PAGE_MASK, "Out of UBO page indices");
+
 		uint32_t slot = p->freeIndices.front();
 		p->freeIndices.pop_front();
 
-		outIdx = slot << 3;
-		outIdx += (slot / countPerPage);
+		outIdx = (slot << STORE_PAGE_BITS) | pageIdx;
 
 		return true;
 
@@ -158,28 +269,95 @@ namespace ubo_store
 		return pages.size();
 	}
 
+	void setModelMatrix(uint32_t idx, const glm::mat4& model)
+	{
+		UBOPage& page = pages[idx & STORE_PAGE_MASK];
+		uint32_t slot = idx >> STORE_PAGE_BITS;
+
+#if COMPUTE_TRANSFORMS
+		transform_compute::setModel(page.firstModel + slot, model);
+#elif SCENE_GRAPH
+		page.models[slot] = model;
+#endif
+	}
+
+#if DIRECT_TO_VRAM
+	//write combined memory: build each slot on the stack, then write it out front to back
+	//in whole slots, never reading from the mapping
+	void writeDirectPage(UBOPage& page, const glm::mat4& viewMatrix, const glm::mat4& projMatrix)
+	{
+		char* dst = (char*)page.map;
+		const uint32_t stride = DYNAMIC_UBO ? slotSize : sizeof(VShaderInput);
+
+		for (uint32_t i = 0; i < countPerPage; ++i)
+		{
+#if SCENE_GRAPH
+			const glm::mat4 modelView = viewMatrix * page.models[i];
+#else
+			const glm::mat4& modelView = viewMatrix;
+#endif
+			VShaderInput slotInput = { projMatrix * modelView, glm::transpose(glm::inverse(modelView)) };
+#if STREAMING_STORES
+			mapped_writer::streamCopy(dst, &slotInput, sizeof(VShaderInput));
+#else
+			memcpy(dst, &slotInput, sizeof(VShaderInput));
+#endif
+			dst += stride;
+		}
+	}
+#endif
+
 	void updateBuffers(const glm::mat4& viewMatrix, const glm::mat4& projMatrix, VkCommandBuffer* commandBuffer, vkh::VkhContext& ctxt)
 	{
-		std::vector<VkMappedMemoryRange> rangesToUpdate;
-		rangesToUpdate.resize(pages.size());
+#if COMPUTE_TRANSFORMS
+		transform_compute::dispatch(viewMatrix, projMatrix, *commandBuffer, ctxt);
+#else
+		VkMappedMemoryRange* rangesToUpdate = frame_allocator::allocHost<VkMappedMemoryRange>(pages.size());
+		uint32_t numRanges = 0;
+
+#if PERSISTENT_STAGING_BUFFER
+		const uint32_t frameOffset = frame_pacer::getFrameIndex() * stagingRegionSize;
+#endif
 
 		for (uint32_t p = 0; p < pages.size(); ++p)
 		{
-			UBOPage page = pages[p];
-			VShaderInput* objPtr = (VShaderInput*)page.map;
+			UBOPage& page = pages[p];
+#if DIRECT_TO_VRAM
+			if (page.directWrite)
+			{
+				writeDirectPage(page, viewMatrix, projMatrix);
+				continue;
+			}
+#endif
+
+			char* dst = (char*)page.map;
+#if PERSISTENT_STAGING_BUFFER
+			dst += frameOffset;
+#endif
+
+			VShaderInput* objPtr = (VShaderInput*)dst;
 
 #if DYNAMIC_UBO
-			char* mapCharPtr = (char*)page.map;
+			char* mapCharPtr = dst;
 #endif
 
 			for (uint32_t i = 0; i < countPerPage; ++i)
 			{
-#if DYNAMIC_UBO				
-				VShaderInput slotInput = { projMatrix * viewMatrix, glm::transpose(glm::inverse(viewMatrix)) };
+#if SCENE_GRAPH
+				const glm::mat4 modelView = viewMatrix * page.models[i];
+#else
+				const glm::mat4& modelView = viewMatrix;
+#endif
+
+#if STREAMING_STORES
+				VShaderInput slotInput = { projMatrix * modelView, glm::transpose(glm::inverse(modelView)) };
+				mapped_writer::streamCopy(dst + i * (DYNAMIC_UBO ? slotSize : sizeof(VShaderInput)), &slotInput, sizeof(VShaderInput));
+#elif DYNAMIC_UBO				
+				VShaderInput slotInput = { projMatrix * modelView, glm::transpose(glm::inverse(modelView)) };
 				memcpy(&mapCharPtr[i * slotSize], &slotInput, sizeof(VShaderInput));
 #else
-				objPtr[i].model = projMatrix * viewMatrix;
-				objPtr[i].normal = glm::transpose(glm::inverse(viewMatrix));
+				objPtr[i].model = projMatrix * modelView;
+				objPtr[i].normal = glm::transpose(glm::inverse(modelView));
 #endif
 			}
 
@@ -187,32 +365,82 @@ namespace ubo_store
 			curRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 #if PERSISTENT_STAGING_BUFFER
 			curRange.memory = page.stagingAlloc.handle;
-			curRange.offset = page.stagingAlloc.offset;
-
+			curRange.offset = page.stagingAlloc.offset + frameOffset;
+			curRange.size = stagingRegionSize;
 #else
 			curRange.memory = page.alloc.handle;
 			curRange.offset = page.alloc.offset;
-#endif
 			curRange.size = page.alloc.size;
+#endif
 			curRange.pNext = nullptr;
 
-			rangesToUpdate[p] = curRange;
+			rangesToUpdate[numRanges++] = curRange;
 		}
 
+		#if STREAMING_STORES
+			//one fence for every page's streaming stores, before anything reads them
+			mapped_writer::streamFence();
+		#endif
+
 		#if !DEVICE_LOCAL || PERSISTENT_STAGING_BUFFER
-			vkFlushMappedMemoryRanges(ctxt.device, rangesToUpdate.size(), rangesToUpdate.data());
+			if (numRanges > 0)
+			{
+				vkFlushMappedMemoryRanges(ctxt.device, numRanges, rangesToUpdate);
+			}
 		#endif
 
 		#if DEVICE_LOCAL
+			#if COPY_ON_MAIN_COMMANDBUFFER
+				//every frame in flight copies into the same pages, last frame's vertex shaders have to be done reading them first
+				vkCmdPipelineBarrier(*commandBuffer,
+					VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+				VkBufferMemoryBarrier* uploadBarriers = frame_allocator::allocHost<VkBufferMemoryBarrier>(pages.size());
+				uint32_t numBarriers = 0;
+			#endif
+
 			for (uint32_t p = 0; p < pages.size(); ++p)
 			{
+				#if DIRECT_TO_VRAM
+					if (pages[p].directWrite) continue;
+				#endif
+
 				#if PERSISTENT_STAGING_BUFFER	
-					vkh::copyBuffer(pages[p].stagingBuf, pages[p].buf, size, 0, 0, commandBuffer, ctxt);
+					vkh::copyBuffer(pages[p].stagingBuf, pages[p].buf, size, frameOffset, 0, commandBuffer, ctxt);
+				#elif FRAME_UPLOAD_RING
+					frame_allocator::uploadToBuffer(pages[p].buf, 0, pages[p].map, size, commandBuffer, ctxt);
 				#else
 					vkh::copyDataToBuffer(&pages[p].buf, size, 0, (char*)pages[p].map, ctxt);
 				#endif
+
+				#if COPY_ON_MAIN_COMMANDBUFFER
+					VkBufferMemoryBarrier& barrier = uploadBarriers[numBarriers++];
+					barrier = {};
+					barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+					barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					barrier.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.buffer = pages[p].buf;
+					barrier.offset = 0;
+					barrier.size = size;
+				#endif
 			}
+
+			#if COPY_ON_MAIN_COMMANDBUFFER
+				//and this frame's draws have to wait for the copies to land
+				if (numBarriers > 0)
+				{
+					vkCmdPipelineBarrier(*commandBuffer,
+						VK_PIPELINE_STAGE_TRANSFER_BIT,
+						VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+						0, 0, nullptr, numBarriers, uploadBarriers, 0, nullptr);
+				}
+			#endif
 		#endif
+#endif
 	}
 
 	VkDescriptorType getDescriptorType()
@@ -75,10 +75,8 @@ namespace vkh
 	{
 		if (fence)
 		{
-			if (vkGetFenceStatus(device, fence) == VK_SUCCESS)
-			{
-				vkWaitForFences(device, 1, &fence, true, 0);
-			}
+			VkResult res = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+			checkf(res == VK_SUCCESS, "Error waiting for fence");
 		}
 	}
 
@@ -172,6 +170,18 @@ namespace vkh
 		checkf(res == VK_SUCCESS, "Error creating command buffer");
 	}
 
+	void createSecondaryCommandBuffer(VkCommandBuffer& outBuffer, VkCommandPool& pool, const VkDevice& lDevice)
+	{
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkResult res = vkAllocateCommandBuffers(lDevice, &allocInfo, &outBuffer);
+		checkf(res == VK_SUCCESS, "Error creating secondary command buffer");
+	}
+
 	uint32_t getMemoryType(const VkPhysicalDevice& device, uint32_t memoryTypeBitsRequirement, VkMemoryPropertyFlags requiredProperties)
 	{
 		VkPhysicalDeviceMemoryProperties memProperties;
@@ -202,6 +212,68 @@ namespace vkh
 		return 0;
 	}
 
+	//memoryTypeBitsRequirement comes from the buffer's VkMemoryRequirements, so this picks the same type createBuffer will
+	bool getHostVisibleDeviceMemoryType(uint32_t& outType, VkDeviceSize& outHeapSize, uint32_t memoryTypeBitsRequirement, const VkPhysicalDevice& device)
+	{
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
+
+		//without resizable BAR this is usually a 256 MB window into vram, with it, it's all of vram
+		const VkMemoryPropertyFlags requiredProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		for (uint32_t memoryIndex = 0; memoryIndex < memProperties.memoryTypeCount; memoryIndex++)
+		{
+			const VkMemoryType& type = memProperties.memoryTypes[memoryIndex];
+
+			if ((memoryTypeBitsRequirement & (1 << memoryIndex)) && (type.propertyFlags & requiredProperties) == requiredProperties)
+			{
+				outType = memoryIndex;
+				outHeapSize = memProperties.memoryHeaps[type.heapIndex].size;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//the memory types a buffer with this usage can live in, from a throwaway buffer that never gets memory bound
+	uint32_t getBufferMemoryTypeBits(VkDeviceSize size, VkBufferUsageFlags usage, VkhContext& ctxt)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer buffer;
+		VkResult res = vkCreateBuffer(ctxt.device, &bufferInfo, nullptr, &buffer);
+		checkf(res == VK_SUCCESS, "Error creating buffer");
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(ctxt.device, buffer, &memRequirements);
+		vkDestroyBuffer(ctxt.device, buffer, nullptr);
+
+		return memRequirements.memoryTypeBits;
+	}
+
+	//everything the allocator holds on the heap memoryType lives on, other memory types on that heap included
+	VkDeviceSize getHeapAllocatedSize(uint32_t memoryType, VkhContext& ctxt)
+	{
+		const VkPhysicalDeviceMemoryProperties& memProps = ctxt.gpu.memProps;
+		const uint32_t heapIndex = memProps.memoryTypes[memoryType].heapIndex;
+
+		VkDeviceSize total = 0;
+		for (uint32_t t = 0; t < memProps.memoryTypeCount; ++t)
+		{
+			if (memProps.memoryTypes[t].heapIndex == heapIndex)
+			{
+				total += ctxt.allocator.allocatedSize(t);
+			}
+		}
+
+		return total;
+	}
+
 	void createFrameBuffers(std::vector<VkFramebuffer>& outBuffers, const VkhSwapChain& swapChain, const VkImageView* depthBufferView, const VkRenderPass& renderPass, const VkDevice& device)
 	{
 		outBuffers.resize(swapChain.imageViews.size());
@@ -312,6 +384,126 @@ namespace vkh
 		vkFreeCommandBuffers(ctxt.device, pool, 1, &commandBuffer.buffer);
 	}
 
+	void createAsyncTransfer(VkhAsyncTransfer& outTransfer, uint32_t count, VkhContext& ctxt)
+	{
+		outTransfer.commandBuffers.resize(count);
+		outTransfer.fences.resize(count);
+		outTransfer.semaphores.resize(count);
+		outTransfer.graphicsDoneSemaphores.resize(count);
+		outTransfer.graphicsWait = VK_NULL_HANDLE;
+		outTransfer.current = 0;
+
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			createCommandBuffer(outTransfer.commandBuffers[i], ctxt.transferCommandPool, ctxt.device);
+			createVkSemaphore(outTransfer.semaphores[i], ctxt.device);
+			createVkSemaphore(outTransfer.graphicsDoneSemaphores[i], ctxt.device);
+
+			VkResult res = vkCreateFence(ctxt.device, &fenceInfo, nullptr, &outTransfer.fences[i]);
+			checkf(res == VK_SUCCESS, "Error creating async transfer fence");
+		}
+	}
+
+	VkCommandBuffer& beginAsyncTransfer(VkhAsyncTransfer& transfer, VkhContext& ctxt)
+	{
+		transfer.current = (transfer.current + 1) % transfer.commandBuffers.size();
+		uint32_t cur = transfer.current;
+
+		//only blocks if the transfer queue is a whole ring behind us
+		vkWaitForFences(ctxt.device, 1, &transfer.fences[cur], VK_TRUE, UINT64_MAX);
+		vkResetFences(ctxt.device, 1, &transfer.fences[cur]);
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkResetCommandBuffer(transfer.commandBuffers[cur], 0);
+		VkResult res = vkBeginCommandBuffer(transfer.commandBuffers[cur], &beginInfo);
+		checkf(res == VK_SUCCESS, "Error beginning async transfer command buffer");
+
+		return transfer.commandBuffers[cur];
+	}
+
+	VkSemaphore submitAsyncTransfer(VkhAsyncTransfer& transfer, VkhContext& ctxt)
+	{
+		uint32_t cur = transfer.current;
+
+		if (transfer.ownershipBarriers.size() > 0)
+		{
+			vkCmdPipelineBarrier(transfer.commandBuffers[cur],
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0, nullptr, static_cast<uint32_t>(transfer.ownershipBarriers.size()), transfer.ownershipBarriers.data(), 0, nullptr);
+		}
+
+		vkEndCommandBuffer(transfer.commandBuffers[cur]);
+
+		//the copies can't start until the last graphics submit is done reading the destination buffers
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = transfer.graphicsWait != VK_NULL_HANDLE ? 1 : 0;
+		submitInfo.pWaitSemaphores = &transfer.graphicsWait;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &transfer.commandBuffers[cur];
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &transfer.semaphores[cur];
+
+		VkResult res = vkQueueSubmit(ctxt.deviceQueues.transferQueue, 1, &submitInfo, transfer.fences[cur]);
+		checkf(res == VK_SUCCESS, "Error submitting async transfer");
+
+		transfer.graphicsWait = VK_NULL_HANDLE;
+		return transfer.semaphores[cur];
+	}
+
+	//the transfer rewrites the whole buffer every time, so ownership only ever goes from the transfer family to the
+	//graphics family. the transfer queue can use it again without a release, the old contents are discarded anyway
+	void addAsyncTransferTarget(VkhAsyncTransfer& transfer, VkBuffer buffer, VkhContext& ctxt)
+	{
+		if (ctxt.gpu.graphicsQueueFamilyIdx == ctxt.gpu.transferQueueFamilyIdx)
+		{
+			return;
+		}
+
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		barrier.srcQueueFamilyIndex = ctxt.gpu.transferQueueFamilyIdx;
+		barrier.dstQueueFamilyIndex = ctxt.gpu.graphicsQueueFamilyIdx;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		transfer.ownershipBarriers.push_back(barrier);
+	}
+
+	//the acquire half of submitAsyncTransfer's release, has to be recorded before anything reads the buffers.
+	//same stage the graphics submit waits on the upload semaphore at
+	void acquireAsyncTransferTargets(VkhAsyncTransfer& transfer, VkCommandBuffer& graphicsCommandBuffer)
+	{
+		if (transfer.ownershipBarriers.size() > 0)
+		{
+			vkCmdPipelineBarrier(graphicsCommandBuffer,
+				VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+				VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+				0, 0, nullptr, static_cast<uint32_t>(transfer.ownershipBarriers.size()), transfer.ownershipBarriers.data(), 0, nullptr);
+		}
+	}
+
+	//for the graphics submit to signal. the next submitAsyncTransfer waits on it
+	VkSemaphore getAsyncTransferGraphicsSemaphore(VkhAsyncTransfer& transfer)
+	{
+		transfer.graphicsWait = transfer.graphicsDoneSemaphores[transfer.current];
+		return transfer.graphicsWait;
+	}
+
 
 	void copyBuffer(VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize size, uint32_t srcOffset, uint32_t dstOffset, VkhCommandBuffer& buffer)
 	{
@@ -368,7 +560,7 @@ namespace vkh
 
 	}
 
-	void createBuffer(VkBuffer& outBuffer, Allocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkhContext& ctxt)
+	static void createBuffer(VkBuffer& outBuffer, Allocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, bool concurrent, VkhContext& ctxt)
 	{
 		VkBufferCreateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -380,7 +572,7 @@ namespace vkh
 		std::vector<uint32_t> queues;
 		queues.push_back(ctxt.gpu.graphicsQueueFamilyIdx);
 
-		if (ctxt.gpu.graphicsQueueFamilyIdx != ctxt.gpu.transferQueueFamilyIdx)
+		if (concurrent && ctxt.gpu.graphicsQueueFamilyIdx != ctxt.gpu.transferQueueFamilyIdx)
 		{
 			queues.push_back(ctxt.gpu.transferQueueFamilyIdx);
 			bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
@@ -399,6 +591,7 @@ namespace vkh
 
 		AllocationCreateInfo allocInfo = {};
 		allocInfo.size = memRequirements.size;
+		allocInfo.alignment = memRequirements.alignment;
 		allocInfo.memoryTypeIndex = getMemoryType(ctxt.gpu.device, memRequirements.memoryTypeBits, properties);
 		allocInfo.usage = properties;
 
@@ -406,6 +599,16 @@ namespace vkh
 		vkBindBufferMemory(ctxt.device, outBuffer, bufferMemory.handle, bufferMemory.offset);
 	}
 
+	void createBuffer(VkBuffer& outBuffer, Allocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkhContext& ctxt)
+	{
+		createBuffer(outBuffer, bufferMemory, size, usage, properties, true, ctxt);
+	}
+
+	void createExclusiveBuffer(VkBuffer& outBuffer, Allocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkhContext& ctxt)
+	{
+		createBuffer(outBuffer, bufferMemory, size, usage, properties, false, ctxt);
+	}
+
 	void copyDataToBuffer(VkBuffer* buffer, uint32_t dataSize, uint32_t dstOffset, char* data, VkhContext& ctxt)
 	{
 		VkBuffer stagingBuffer;
@@ -418,13 +621,7 @@ namespace vkh
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			ctxt);
 
-		void* mappedStagingBuffer;
-		vkMapMemory(ctxt.device, stagingMemory.handle, stagingMemory.offset, dataSize, 0, &mappedStagingBuffer);
-
-		memset(mappedStagingBuffer, 0, dataSize);
-		memcpy(mappedStagingBuffer, data, dataSize);
-
-		vkUnmapMemory(ctxt.device, stagingMemory.handle);
+		memcpy(stagingMemory.map, data, dataSize);
 
 		vkh::VkhCommandBuffer scratch = vkh::beginScratchCommandBuffer(vkh::ECommandPoolType::Transfer, ctxt);
 		vkh::copyBuffer(stagingBuffer, *buffer, dataSize, 0, dstOffset, scratch);
@@ -564,6 +761,7 @@ namespace vkh
 
 		AllocationCreateInfo createInfo;
 		createInfo.size = memRequirements.size;
+		createInfo.alignment = memRequirements.alignment;
 		createInfo.memoryTypeIndex = getMemoryType(ctxt.gpu.device, memRequirements.memoryTypeBits, properties);
 		createInfo.usage = properties;
 		allocateDeviceMemory(outMem, createInfo, ctxt);
@@ -600,6 +798,7 @@ namespace vkh
 
 		AllocationCreateInfo allocInfo = {};
 		allocInfo.size = memRequirements.size;
+		allocInfo.alignment = memRequirements.alignment;
 		allocInfo.memoryTypeIndex = getMemoryType(ctxt.gpu.device, memRequirements.memoryTypeBits, properties);
 		allocInfo.usage = properties;
 
@@ -19,12 +19,23 @@ namespace vkh
 	void freeDeviceMemory(Allocation& mem);
 	void createRenderPass(VkRenderPass& outPass, std::vector<VkAttachmentDescription>& colorAttachments, VkAttachmentDescription* depthAttachment, const VkDevice& device);
 	void createCommandBuffer(VkCommandBuffer& outBuffer, VkCommandPool& pool, const VkDevice& lDevice);
+	void createSecondaryCommandBuffer(VkCommandBuffer& outBuffer, VkCommandPool& pool, const VkDevice& lDevice);
 	uint32_t getMemoryType(const VkPhysicalDevice& device, uint32_t memoryTypeBitsRequirement, VkMemoryPropertyFlags requiredProperties);
+	bool getHostVisibleDeviceMemoryType(uint32_t& outType, VkDeviceSize& outHeapSize, uint32_t memoryTypeBitsRequirement, const VkPhysicalDevice& device);
+	uint32_t getBufferMemoryTypeBits(VkDeviceSize size, VkBufferUsageFlags usage, VkhContext& ctxt);
+	VkDeviceSize getHeapAllocatedSize(uint32_t memoryType, VkhContext& ctxt);
 	void createFrameBuffers(std::vector<VkFramebuffer>& outBuffers, const VkhSwapChain& swapChain, const VkImageView* depthBufferView, const VkRenderPass& renderPass, const VkDevice& device);
 	void allocateDeviceMemory(Allocation& outMem, AllocationCreateInfo info, VkhContext& ctxt);
 	VkhCommandBuffer beginScratchCommandBuffer(ECommandPoolType type, VkhContext& ctxt);
 	void submitScratchCommandBuffer(VkhCommandBuffer& commandBuffer);
 
+	void createAsyncTransfer(VkhAsyncTransfer& outTransfer, uint32_t count, VkhContext& ctxt);
+	VkCommandBuffer& beginAsyncTransfer(VkhAsyncTransfer& transfer, VkhContext& ctxt);
+	VkSemaphore submitAsyncTransfer(VkhAsyncTransfer& transfer, VkhContext& ctxt);
+	void addAsyncTransferTarget(VkhAsyncTransfer& transfer, VkBuffer buffer, VkhContext& ctxt);
+	void acquireAsyncTransferTargets(VkhAsyncTransfer& transfer, VkCommandBuffer& graphicsCommandBuffer);
+	VkSemaphore getAsyncTransferGraphicsSemaphore(VkhAsyncTransfer& transfer);
+
 	//todo: do we really need three of these? 
 	void copyBuffer(VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize size, uint32_t srcOffset, uint32_t dstOffset, VkhCommandBuffer& buffer);
 	void copyBuffer(VkBuffer& srcBuffer, VkBuffer& dstBuffer, VkDeviceSize size, uint32_t srcOffset, uint32_t dstOffset, VkCommandBuffer& buffer);
@@ -32,6 +43,7 @@ namespace vkh
 
 	void createShaderModule(VkShaderModule& outModule, const char* binaryData, size_t dataSize, const VkhContext& ctxt);
 	void createBuffer(VkBuffer& outBuffer, Allocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkhContext& ctxt);
+	void createExclusiveBuffer(VkBuffer& outBuffer, Allocation& bufferMemory, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkhContext& ctxt);
 	void copyDataToBuffer(VkBuffer* buffer, uint32_t dataSize, uint32_t dstOffset, char* data, VkhContext& ctxt);
 	void createImage(VkImage& outImage, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, const VkhContext& ctxt);
 	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkhContext& ctxt);
@@ -2,15 +2,54 @@
 #include <stdint.h>
 #include "vkh.h"
 #include "vkh_types.h"
+#include "vkh_memory_backend.h"
+#include "vkh_defrag.h"
+#include "config.h"
+#include <intrin.h>
+#include <string.h>
 
 //Simple Passthrough allocator -> sub allocators responsible for actually parcelling out memory
 
+namespace vkh::allocators
+{
+	uint32_t histogramBucket(VkDeviceSize size)
+	{
+		unsigned long msb;
+		_BitScanReverse64(&msb, size | 1);
+
+		uint32_t bucket = msb > 9 ? msb - 9 : 0;
+		return bucket < ALLOC_HISTOGRAM_BUCKETS ? bucket : ALLOC_HISTOGRAM_BUCKETS - 1;
+	}
+
+	//allocation count and size histogram, every allocator keeps these per memory type the same way
+	void countAlloc(MemoryTypeStats& stats, VkDeviceSize size)
+	{
+		stats.allocationCount++;
+		stats.sizeHistogram[histogramBucket(size)]++;
+	}
+
+	void countFree(MemoryTypeStats& stats, VkDeviceSize size)
+	{
+		stats.allocationCount--;
+		stats.sizeHistogram[histogramBucket(size)]--;
+	}
+
+	//host visible memory is mapped once when it's allocated and stays mapped until it's freed, so any number
+	//of allocations can share a block and each one's pointer is just the block's plus its offset
+	char* mapIfHostVisible(VkhContext* context, VkDeviceMemory memory, uint32_t memoryType)
+	{
+		if (!(context->gpu.memProps.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) return nullptr;
+		return (char*)memory_backend::map(context->device, memory);
+	}
+}
+
 namespace vkh::allocators::passthrough
 {
 	struct AllocatorState
 	{
 		size_t* memTypeAllocSizes;
 		uint32_t totalAllocs;
+		std::vector<MemoryTypeStats> typeStats;
 
 		VkhContext* context;
 	};
@@ -23,8 +62,10 @@ namespace vkh::allocators::passthrough
 	void free(Allocation& handle);
 	size_t allocatedSize(uint32_t memoryType);
 	uint32_t numAllocs();
+	void getStats(uint32_t memoryType, MemoryTypeStats& outStats);
+	const char* getName();
 
-	AllocatorInterface allocImpl = { activate, alloc, free, allocatedSize, numAllocs };
+	AllocatorInterface allocImpl = { activate, alloc, free, allocatedSize, numAllocs, getStats, getName };
 
 	void activate(VkhContext* context)
 	{
@@ -34,7 +75,10 @@ namespace vkh::allocators::passthrough
 		VkPhysicalDeviceMemoryProperties memProperties;
 		vkGetPhysicalDeviceMemoryProperties(context->gpu.device, &memProperties);
 
+		::free(state.memTypeAllocSizes);
 		state.memTypeAllocSizes = (size_t*)calloc(1, sizeof(size_t) * memProperties.memoryTypeCount);
+		state.totalAllocs = 0;
+		state.typeStats.assign(memProperties.memoryTypeCount, {});
 	}
 
 	void deactivate(VkhContext* context)
@@ -49,9 +93,9 @@ namespace vkh::allocators::passthrough
 	{
 		state.totalAllocs++;
 		state.memTypeAllocSizes[createInfo.memoryTypeIndex] += createInfo.size;
+		countAlloc(state.typeStats[createInfo.memoryTypeIndex], createInfo.size);
 
-		VkMemoryAllocateInfo allocInfo = vkh::memoryAllocateInfo(createInfo.size, createInfo.memoryTypeIndex);
-		VkResult res = vkAllocateMemory(state.context->device, &allocInfo, nullptr, &(outAlloc.handle));
+		VkResult res = memory_backend::allocate(state.context->device, createInfo.size, createInfo.memoryTypeIndex, outAlloc.handle);
 
 		outAlloc.size = createInfo.size;
 		outAlloc.type = createInfo.memoryTypeIndex;
@@ -61,13 +105,16 @@ namespace vkh::allocators::passthrough
 		checkf(res != VK_ERROR_OUT_OF_DEVICE_MEMORY, "Out of device memory");
 		checkf(res != VK_ERROR_TOO_MANY_OBJECTS, "Attempting to create too many allocations")
 		checkf(res == VK_SUCCESS, "Error allocating memory in passthrough allocator");
+
+		outAlloc.map = mapIfHostVisible(state.context, outAlloc.handle, outAlloc.type);
 	}
 
 	void free(Allocation& allocation)
 	{
 		state.totalAllocs--;
 		state.memTypeAllocSizes[allocation.type] -= allocation.size;
-		vkFreeMemory(state.context->device, (allocation.handle), nullptr);
+		countFree(state.typeStats[allocation.type], allocation.size);
+		memory_backend::free(state.context->device, allocation.handle);
 	}
 
 	size_t allocatedSize(uint32_t memoryType)
@@ -79,6 +126,21 @@ namespace vkh::allocators::passthrough
 	{
 		return state.totalAllocs;
 	}
+
+	//every allocation is its own block, there's never any free space
+	void getStats(uint32_t memoryType, MemoryTypeStats& outStats)
+	{
+		outStats = state.typeStats[memoryType];
+		outStats.committed = state.memTypeAllocSizes[memoryType];
+		outStats.used = state.memTypeAllocSizes[memoryType];
+		outStats.largestFreeSpan = 0;
+		outStats.blockCount = outStats.allocationCount;
+	}
+
+	const char* getName()
+	{
+		return "passthrough";
+	}
 }
 
 namespace vkh::allocators::pool
@@ -86,11 +148,17 @@ namespace vkh::allocators::pool
 	struct OffsetSize { uint64_t offset; uint64_t size; };
 	struct BlockSpanIndexPair { uint32_t blockIdx; uint32_t spanIdx; };
 
+	//released blocks keep their slot, so block indices stored in allocations stay valid, with mem.handle set to VK_NULL_HANDLE
 	struct DeviceMemoryBlock
 	{
 		Allocation mem;
 		std::vector<OffsetSize> layout;
-		bool pageReserved;
+
+		VkDeviceSize usedBytes;
+		uint32_t liveAllocs;
+
+		//being emptied by the defragmenter, nothing new is allocated from it
+		bool evacuating;
 	};
 
 	struct MemoryPool
@@ -109,6 +177,7 @@ namespace vkh::allocators::pool
 		VkDeviceSize memoryBlockMinSize;
 
 		std::vector<MemoryPool> memPools;
+		std::vector<MemoryTypeStats> typeStats;
 	};
 
 	AllocatorState state;
@@ -119,8 +188,10 @@ namespace vkh::allocators::pool
 	void free(Allocation& handle);
 	size_t allocatedSize(uint32_t memoryType);
 	uint32_t numAllocs();
+	void getStats(uint32_t memoryType, MemoryTypeStats& outStats);
+	const char* getName();
 
-	AllocatorInterface allocImpl = { activate, alloc, free, allocatedSize, numAllocs };
+	AllocatorInterface allocImpl = { activate, alloc, free, allocatedSize, numAllocs, getStats, getName };
 
 	void activate(VkhContext* context)
 	{
@@ -130,22 +201,24 @@ namespace vkh::allocators::pool
 		VkPhysicalDeviceMemoryProperties memProperties;
 		vkGetPhysicalDeviceMemoryProperties(context->gpu.device, &memProperties);
 
-		state.memTypeAllocSizes.resize(memProperties.memoryTypeCount);
+		//activating again starts over with no blocks, anything still allocated from the old ones is forgotten
+		state.memTypeAllocSizes.assign(memProperties.memoryTypeCount, 0);
+		state.memPools.clear();
 		state.memPools.resize(memProperties.memoryTypeCount);
+		state.typeStats.assign(memProperties.memoryTypeCount, {});
+		state.totalAllocs = 0;
 
 		state.pageSize = 1024; //can't use context->gpu.deviceProps.limits.bufferImageGranularity because some AMD cards set this to 1
 		state.memoryBlockMinSize = state.pageSize * 10;
 	}
 
-	uint32_t addBlockToPool(VkDeviceSize size, uint32_t memoryType, bool fitToAlloc)
+	uint32_t addBlockToPool(VkDeviceSize size, uint32_t memoryType)
 	{
 		VkDeviceSize newPoolSize = size * 2;
 		newPoolSize = newPoolSize < state.memoryBlockMinSize ? state.memoryBlockMinSize : newPoolSize;
 
-		VkMemoryAllocateInfo info = vkh::memoryAllocateInfo(newPoolSize, memoryType);
-
 		DeviceMemoryBlock newBlock = {};
-		VkResult res = vkAllocateMemory(state.context->device, &info, nullptr, &newBlock.mem.handle);
+		VkResult res = memory_backend::allocate(state.context->device, newPoolSize, memoryType, newBlock.mem.handle);
 
 		checkf(res != VK_ERROR_OUT_OF_DEVICE_MEMORY, "Out of device memory");
 		checkf(res != VK_ERROR_TOO_MANY_OBJECTS, "Attempting to create too many allocations")
@@ -153,15 +226,37 @@ namespace vkh::allocators::pool
 
 		newBlock.mem.type = memoryType;
 		newBlock.mem.size = newPoolSize;
+		newBlock.mem.map = mapIfHostVisible(state.context, newBlock.mem.handle, memoryType);
+		newBlock.layout.push_back({ 0, newPoolSize });
+
+		state.totalAllocs++;
 
+		//the slot of a released block is reused before the list grows
 		MemoryPool& pool = state.memPools[memoryType];
+		for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+		{
+			if (pool.blocks[i].mem.handle == VK_NULL_HANDLE)
+			{
+				pool.blocks[i] = newBlock;
+				return i;
+			}
+		}
+
 		pool.blocks.push_back(newBlock);
+		return pool.blocks.size() - 1;
+	}
 
-		pool.blocks[pool.blocks.size() - 1].layout.push_back({ 0, newPoolSize });
+	void releaseBlock(uint32_t memoryType, uint32_t blockIdx)
+	{
+		DeviceMemoryBlock& block = state.memPools[memoryType].blocks[blockIdx];
 
-		state.totalAllocs++;
+		memory_backend::free(state.context->device, block.mem.handle);
+		block.mem.handle = VK_NULL_HANDLE;
+		block.mem.map = nullptr;
+		block.layout.clear();
+		block.evacuating = false;
 
-		return pool.blocks.size() - 1;
+		state.totalAllocs--;
 	}
 
 	void markChunkOfMemoryBlockUsed(uint32_t memoryType, BlockSpanIndexPair indices, VkDeviceSize size)
@@ -172,16 +267,17 @@ namespace vkh::allocators::pool
 		pool.blocks[indices.blockIdx].layout[indices.spanIdx].size -= size;
 	}
 
-	bool findFreeChunkForAllocation(BlockSpanIndexPair& outIndexPair, uint32_t memoryType, VkDeviceSize size, bool needsWholePage)
+	bool findFreeChunkForAllocation(BlockSpanIndexPair& outIndexPair, uint32_t memoryType, VkDeviceSize size)
 	{
 		MemoryPool& pool = state.memPools[memoryType];
 
 		for (uint32_t i = 0; i < pool.blocks.size(); ++i)
 		{
+			if (pool.blocks[i].evacuating) continue;
+
 			for (uint32_t j = 0; j < pool.blocks[i].layout.size(); ++j)
 			{
-				bool validOffset = needsWholePage ? pool.blocks[i].layout[j].offset == 0 : true;
-				if (pool.blocks[i].layout[j].size >= size && validOffset)
+				if (pool.blocks[i].layout[j].size >= size)
 				{
 					outIndexPair.blockIdx = i;
 					outIndexPair.spanIdx = j;
@@ -201,18 +297,19 @@ namespace vkh::allocators::pool
 		//make sure we always alloc a multiple of pageSize
 		VkDeviceSize requestedAllocSize = ((size / state.pageSize) + 1) * state.pageSize;
 		state.memTypeAllocSizes[memoryType] += requestedAllocSize;
+		countAlloc(state.typeStats[memoryType], size);
 
 		BlockSpanIndexPair location;
 
-		bool needsOwnPage = createInfo.usage != VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-		bool found = findFreeChunkForAllocation(location, memoryType, requestedAllocSize, needsOwnPage);
+		bool found = findFreeChunkForAllocation(location, memoryType, requestedAllocSize);
 
 		if (!found)
 		{
-			location = { addBlockToPool(requestedAllocSize, memoryType, needsOwnPage), 0 };
+			location = { addBlockToPool(requestedAllocSize, memoryType), 0 };
 		}
 
-		pool.blocks[location.blockIdx].pageReserved = needsOwnPage;
+		pool.blocks[location.blockIdx].usedBytes += requestedAllocSize;
+		pool.blocks[location.blockIdx].liveAllocs++;
 
 		outAlloc.handle = pool.blocks[location.blockIdx].mem.handle;
 		outAlloc.size = size;
@@ -220,6 +317,7 @@ namespace vkh::allocators::pool
 		outAlloc.type = memoryType;
 		outAlloc.id = location.blockIdx;
 		outAlloc.context = state.context;
+		outAlloc.map = pool.blocks[location.blockIdx].mem.map ? (char*)pool.blocks[location.blockIdx].mem.map + outAlloc.offset : nullptr;
 
 		markChunkOfMemoryBlockUsed(memoryType, location, requestedAllocSize);
 	}
@@ -230,8 +328,13 @@ namespace vkh::allocators::pool
 
 		OffsetSize span = { allocation.offset, requestedAllocSize };
 
+		//alloc always adds the rounded size, so it comes off whether or not the span merges below
+		state.memTypeAllocSizes[allocation.type] -= requestedAllocSize;
+		countFree(state.typeStats[allocation.type], allocation.size);
+
 		MemoryPool& pool = state.memPools[allocation.type];
-		pool.blocks[allocation.id].pageReserved = false;
+		pool.blocks[allocation.id].usedBytes -= requestedAllocSize;
+		pool.blocks[allocation.id].liveAllocs--;
 
 		bool found = false;
 
@@ -250,7 +353,6 @@ namespace vkh::allocators::pool
 		if (!found)
 		{
 			state.memPools[allocation.type].blocks[allocation.id].layout.push_back(span);
-			state.memTypeAllocSizes[allocation.type] -= requestedAllocSize;
 		}
 	}
 
@@ -264,8 +366,528 @@ namespace vkh::allocators::pool
 		return state.totalAllocs;
 	}
 
+	void getStats(uint32_t memoryType, MemoryTypeStats& outStats)
+	{
+		outStats = state.typeStats[memoryType];
+		outStats.used = state.memTypeAllocSizes[memoryType];
+		outStats.committed = 0;
+		outStats.largestFreeSpan = 0;
+
+		outStats.blockCount = 0;
+
+		for (const DeviceMemoryBlock& block : state.memPools[memoryType].blocks)
+		{
+			if (block.mem.handle == VK_NULL_HANDLE) continue;
+
+			outStats.blockCount++;
+			outStats.committed += block.mem.size;
+			for (const OffsetSize& span : block.layout)
+			{
+				outStats.largestFreeSpan = span.size > outStats.largestFreeSpan ? span.size : outStats.largestFreeSpan;
+			}
+		}
+	}
+
+	const char* getName()
+	{
+		return "pool";
+	}
+
+	//the emptiest device local block whose allocations can all be moved, as long as the type's other blocks have room
+	//for its contents twice over. Otherwise moving would mostly just allocate a new block to move into
+	//host visible blocks are persistently mapped and their owners hold pointers into them. They're also
+	//where staging buffers churn, so releasing them when empty would just reallocate them next upload
+	bool canDefragType(uint32_t memoryType)
+	{
+		VkMemoryPropertyFlags flags = state.context->gpu.memProps.memoryTypes[memoryType].propertyFlags;
+		return (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	}
+
+	bool pickBlockToEvacuate(uint32_t& outType, uint32_t& outBlock)
+	{
+		double lowestOccupancy = DEFRAG_MAX_OCCUPANCY;
+		bool found = false;
+
+		for (uint32_t t = 0; t < state.memPools.size(); ++t)
+		{
+			if (!canDefragType(t)) continue;
+
+			const MemoryPool& pool = state.memPools[t];
+
+			VkDeviceSize freeBytes = 0;
+			for (const DeviceMemoryBlock& block : pool.blocks)
+			{
+				if (block.mem.handle != VK_NULL_HANDLE && !block.evacuating) freeBytes += block.mem.size - block.usedBytes;
+			}
+
+			for (uint32_t b = 0; b < pool.blocks.size(); ++b)
+			{
+				const DeviceMemoryBlock& block = pool.blocks[b];
+				if (block.mem.handle == VK_NULL_HANDLE || block.evacuating || block.liveAllocs == 0) continue;
+
+				double occupancy = block.usedBytes / (double)block.mem.size;
+				VkDeviceSize freeElsewhere = freeBytes - (block.mem.size - block.usedBytes);
+
+				if (occupancy >= lowestOccupancy || freeElsewhere < block.usedBytes * 2) continue;
+				if (defrag::countMovable(block.mem.handle) != block.liveAllocs) continue;
+
+				lowestOccupancy = occupancy;
+				outType = t;
+				outBlock = b;
+				found = true;
+			}
+		}
+
+		return found;
+	}
+
+	//call once a frame. Releases empty blocks, then keeps moving buffers out of one sparse block for up to
+	//budgetMs a frame until it's empty and can be released too
+	void defragStep(VkhContext& ctxt, double budgetMs)
+	{
+		defrag::retireFrame();
+
+		bool evacuating = false;
+		uint32_t evacType = 0;
+		uint32_t evacBlock = 0;
+
+		for (uint32_t t = 0; t < state.memPools.size(); ++t)
+		{
+			if (!canDefragType(t)) continue;
+
+			for (uint32_t b = 0; b < state.memPools[t].blocks.size(); ++b)
+			{
+				const DeviceMemoryBlock& block = state.memPools[t].blocks[b];
+				if (block.mem.handle == VK_NULL_HANDLE) continue;
+
+				if (block.liveAllocs == 0)
+				{
+					releaseBlock(t, b);
+				}
+				else if (block.evacuating)
+				{
+					evacuating = true;
+					evacType = t;
+					evacBlock = b;
+				}
+			}
+		}
+
+		if (!evacuating && pickBlockToEvacuate(evacType, evacBlock))
+		{
+			state.memPools[evacType].blocks[evacBlock].evacuating = true;
+			evacuating = true;
+		}
+
+		if (evacuating)
+		{
+			defrag::evacuate(state.memPools[evacType].blocks[evacBlock].mem.handle, budgetMs, ctxt);
+		}
+	}
+
 	void deactivate(VkhContext* context)
 	{
 	}
 
+}
+
+//Two level segregated fit allocator: free spans are kept in lists bucketed by size, first level by power of two and
+//second level by SL_COUNT linear steps within it. Two bitmaps record which lists are non empty, so finding a span
+//and giving one back are both a handful of bit scans, no matter how many allocations are live
+
+namespace vkh::allocators::tlsf
+{
+	const uint32_t SL_BITS = 5;
+	const uint32_t SL_COUNT = 1 << SL_BITS;
+	const uint32_t FL_COUNT = 48;
+	const uint32_t NO_SPAN = 0xFFFFFFFF;
+
+	const VkDeviceSize BLOCK_SIZE = 64 * 1024 * 1024;
+	const VkDeviceSize MIN_GRANULARITY = 256;
+
+	struct Span
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint32_t block;
+
+		//neighbours by address within the block, for coalescing
+		uint32_t prevPhys;
+		uint32_t nextPhys;
+
+		//neighbours in the span's free list, only meaningful while it's free
+		uint32_t prevFree;
+		uint32_t nextFree;
+
+		bool isFree;
+	};
+
+	struct MemoryPool
+	{
+		std::vector<VkDeviceMemory> blocks;
+
+		//where each block is mapped, nullptr unless the memory type is host visible
+		std::vector<char*> blockMaps;
+
+		uint64_t flBitmap;
+		uint32_t slBitmap[FL_COUNT];
+		uint32_t freeHeads[FL_COUNT][SL_COUNT];
+
+		VkDeviceSize committed;
+	};
+
+	struct AllocatorState
+	{
+		VkhContext* context;
+
+		std::vector<size_t> memTypeAllocSizes;
+		uint32_t totalAllocs;
+
+		//every span starts and ends on a multiple of this, which also keeps buffers and images off each other's pages
+		VkDeviceSize granularity;
+
+		std::vector<MemoryPool> memPools;
+
+		//span storage shared by every pool, unusedSpans are slots free for reuse
+		std::vector<Span> spans;
+		std::vector<uint32_t> unusedSpans;
+
+		std::vector<MemoryTypeStats> typeStats;
+	};
+
+	AllocatorState state;
+
+	//ALLOCATOR INTERFACE / INSTALLATION 
+	void activate(VkhContext* context);
+	void alloc(Allocation& outAlloc, AllocationCreateInfo createInfo);
+	void free(Allocation& handle);
+	size_t allocatedSize(uint32_t memoryType);
+	uint32_t numAllocs();
+	void getStats(uint32_t memoryType, MemoryTypeStats& outStats);
+	const char* getName();
+
+	AllocatorInterface allocImpl = { activate, alloc, free, allocatedSize, numAllocs, getStats, getName };
+
+	void activate(VkhContext* context)
+	{
+		context->allocator = allocImpl;
+		state.context = context;
+
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(context->gpu.device, &memProperties);
+
+		state.memTypeAllocSizes.assign(memProperties.memoryTypeCount, 0);
+		state.memPools.clear();
+		state.memPools.resize(memProperties.memoryTypeCount);
+		state.spans.clear();
+		state.unusedSpans.clear();
+		state.typeStats.assign(memProperties.memoryTypeCount, {});
+		state.totalAllocs = 0;
+
+		for (MemoryPool& pool : state.memPools)
+		{
+			pool.committed = 0;
+			pool.flBitmap = 0;
+			memset(pool.slBitmap, 0, sizeof(pool.slBitmap));
+			memset(pool.freeHeads, 0xFF, sizeof(pool.freeHeads));
+		}
+
+		VkDeviceSize granularity = context->gpu.deviceProps.limits.bufferImageGranularity;
+		state.granularity = granularity > MIN_GRANULARITY ? granularity : MIN_GRANULARITY;
+	}
+
+	void deactivate(VkhContext* context)
+	{
+	}
+
+	//IMPLEMENTATION
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	//sizes are always >= MIN_GRANULARITY, so there are always SL_BITS bits below the first level bit to index with
+	void mapping(VkDeviceSize size, uint32_t& outFl, uint32_t& outSl)
+	{
+		unsigned long msb;
+		_BitScanReverse64(&msb, size);
+
+		outFl = msb;
+		outSl = static_cast<uint32_t>(size >> (msb - SL_BITS)) - SL_COUNT;
+	}
+
+	//rounds size up to the next list boundary first, so any span in the list found is big enough (good fit)
+	void searchMapping(VkDeviceSize size, uint32_t& outFl, uint32_t& outSl)
+	{
+		unsigned long msb;
+		_BitScanReverse64(&msb, size);
+
+		mapping(size + (1ull << (msb - SL_BITS)) - 1, outFl, outSl);
+	}
+
+	uint32_t newSpan()
+	{
+		if (state.unusedSpans.size() > 0)
+		{
+			uint32_t idx = state.unusedSpans.back();
+			state.unusedSpans.pop_back();
+			return idx;
+		}
+
+		state.spans.push_back({});
+		return static_cast<uint32_t>(state.spans.size() - 1);
+	}
+
+	void insertFree(MemoryPool& pool, uint32_t idx)
+	{
+		uint32_t fl, sl;
+		mapping(state.spans[idx].size, fl, sl);
+
+		Span& span = state.spans[idx];
+		span.isFree = true;
+		span.prevFree = NO_SPAN;
+		span.nextFree = pool.freeHeads[fl][sl];
+
+		if (span.nextFree != NO_SPAN)
+		{
+			state.spans[span.nextFree].prevFree = idx;
+		}
+
+		pool.freeHeads[fl][sl] = idx;
+		pool.flBitmap |= 1ull << fl;
+		pool.slBitmap[fl] |= 1u << sl;
+	}
+
+	void removeFree(MemoryPool& pool, uint32_t idx)
+	{
+		uint32_t fl, sl;
+		mapping(state.spans[idx].size, fl, sl);
+
+		Span& span = state.spans[idx];
+		span.isFree = false;
+
+		if (span.prevFree != NO_SPAN) state.spans[span.prevFree].nextFree = span.nextFree;
+		if (span.nextFree != NO_SPAN) state.spans[span.nextFree].prevFree = span.prevFree;
+
+		if (pool.freeHeads[fl][sl] == idx)
+		{
+			pool.freeHeads[fl][sl] = span.nextFree;
+
+			if (span.nextFree == NO_SPAN)
+			{
+				pool.slBitmap[fl] &= ~(1u << sl);
+				if (pool.slBitmap[fl] == 0)
+				{
+					pool.flBitmap &= ~(1ull << fl);
+				}
+			}
+		}
+	}
+
+	uint32_t findFree(MemoryPool& pool, VkDeviceSize size)
+	{
+		uint32_t fl, sl;
+		searchMapping(size, fl, sl);
+		if (fl >= FL_COUNT) return NO_SPAN;
+
+		//a bigger list in the same power of two, or failing that the smallest non empty list above it
+		uint32_t slMap = pool.slBitmap[fl] & (~0u << sl);
+		if (slMap == 0)
+		{
+			uint64_t flMap = pool.flBitmap & (~0ull << (fl + 1));
+			if (flMap == 0) return NO_SPAN;
+
+			unsigned long foundFl;
+			_BitScanForward64(&foundFl, flMap);
+			fl = foundFl;
+			slMap = pool.slBitmap[fl];
+		}
+
+		unsigned long foundSl;
+		_BitScanForward(&foundSl, slMap);
+
+		return pool.freeHeads[fl][foundSl];
+	}
+
+	//the whole block starts out as one free span, returned already taken off the free lists
+	uint32_t addBlockToPool(VkDeviceSize size, uint32_t memoryType)
+	{
+		VkDeviceMemory block;
+		VkResult res = memory_backend::allocate(state.context->device, size, memoryType, block);
+
+		checkf(res != VK_ERROR_OUT_OF_DEVICE_MEMORY, "Out of device memory");
+		checkf(res != VK_ERROR_TOO_MANY_OBJECTS, "Attempting to create too many allocations")
+		checkf(res == VK_SUCCESS, "Error allocating memory in tlsf allocator");
+
+		MemoryPool& pool = state.memPools[memoryType];
+		pool.blocks.push_back(block);
+		pool.blockMaps.push_back(mapIfHostVisible(state.context, block, memoryType));
+		pool.committed += size;
+		state.totalAllocs++;
+
+		uint32_t idx = newSpan();
+		Span& span = state.spans[idx];
+		span.offset = 0;
+		span.size = size;
+		span.block = static_cast<uint32_t>(pool.blocks.size() - 1);
+		span.prevPhys = NO_SPAN;
+		span.nextPhys = NO_SPAN;
+		span.isFree = false;
+
+		return idx;
+	}
+
+	//carves [offset, offset + size) off the front of span idx into a new span, which is returned
+	uint32_t splitFront(uint32_t idx, VkDeviceSize size)
+	{
+		uint32_t front = newSpan();
+		Span& span = state.spans[idx];
+		Span& frontSpan = state.spans[front];
+
+		frontSpan.offset = span.offset;
+		frontSpan.size = size;
+		frontSpan.block = span.block;
+		frontSpan.prevPhys = span.prevPhys;
+		frontSpan.nextPhys = idx;
+		frontSpan.isFree = false;
+
+		if (span.prevPhys != NO_SPAN) state.spans[span.prevPhys].nextPhys = front;
+		span.prevPhys = front;
+		span.offset += size;
+		span.size -= size;
+
+		return front;
+	}
+
+	void alloc(Allocation& outAlloc, AllocationCreateInfo createInfo)
+	{
+		uint32_t memoryType = createInfo.memoryTypeIndex;
+		VkDeviceSize size = alignUp(createInfo.size, state.granularity);
+
+		state.memTypeAllocSizes[memoryType] += size;
+		countAlloc(state.typeStats[memoryType], createInfo.size);
+
+		outAlloc.size = createInfo.size;
+		outAlloc.type = memoryType;
+		outAlloc.context = state.context;
+
+		MemoryPool& pool = state.memPools[memoryType];
+
+		//span offsets are already granularity aligned, a bigger alignment can need up to alignment - granularity of padding
+		VkDeviceSize alignment = createInfo.alignment > state.granularity ? createInfo.alignment : state.granularity;
+		VkDeviceSize searchSize = size + alignment - state.granularity;
+
+		uint32_t idx = findFree(pool, searchSize);
+		if (idx != NO_SPAN)
+		{
+			removeFree(pool, idx);
+		}
+		else
+		{
+			idx = addBlockToPool(searchSize > BLOCK_SIZE ? alignUp(searchSize, state.granularity) : BLOCK_SIZE, memoryType);
+		}
+
+		//padding in front goes back on the free lists as a span of its own
+		VkDeviceSize padding = alignUp(state.spans[idx].offset, alignment) - state.spans[idx].offset;
+		if (padding > 0)
+		{
+			insertFree(pool, splitFront(idx, padding));
+		}
+
+		//and so does whatever is left over behind the allocation
+		if (state.spans[idx].size > size)
+		{
+			uint32_t used = splitFront(idx, size);
+			insertFree(pool, idx);
+			idx = used;
+		}
+
+		const Span& span = state.spans[idx];
+		outAlloc.handle = pool.blocks[span.block];
+		outAlloc.offset = span.offset;
+		outAlloc.id = idx;
+		outAlloc.map = pool.blockMaps[span.block] ? pool.blockMaps[span.block] + span.offset : nullptr;
+	}
+
+	void free(Allocation& allocation)
+	{
+		VkDeviceSize size = alignUp(allocation.size, state.granularity);
+		state.memTypeAllocSizes[allocation.type] -= size;
+		countFree(state.typeStats[allocation.type], allocation.size);
+
+		MemoryPool& pool = state.memPools[allocation.type];
+		uint32_t idx = allocation.id;
+
+		//absorb free neighbours on both sides, so free space never sits in adjacent spans
+		uint32_t next = state.spans[idx].nextPhys;
+		if (next != NO_SPAN && state.spans[next].isFree)
+		{
+			removeFree(pool, next);
+
+			state.spans[idx].size += state.spans[next].size;
+			state.spans[idx].nextPhys = state.spans[next].nextPhys;
+			if (state.spans[next].nextPhys != NO_SPAN) state.spans[state.spans[next].nextPhys].prevPhys = idx;
+
+			state.unusedSpans.push_back(next);
+		}
+
+		uint32_t prev = state.spans[idx].prevPhys;
+		if (prev != NO_SPAN && state.spans[prev].isFree)
+		{
+			removeFree(pool, prev);
+
+			state.spans[prev].size += state.spans[idx].size;
+			state.spans[prev].nextPhys = state.spans[idx].nextPhys;
+			if (state.spans[idx].nextPhys != NO_SPAN) state.spans[state.spans[idx].nextPhys].prevPhys = prev;
+
+			state.unusedSpans.push_back(idx);
+			idx = prev;
+		}
+
+		insertFree(pool, idx);
+	}
+
+	size_t allocatedSize(uint32_t memoryType)
+	{
+		return state.memTypeAllocSizes[memoryType];
+	}
+
+	uint32_t numAllocs()
+	{
+		return state.totalAllocs;
+	}
+
+	//the biggest span is in the highest non empty list, but that list covers a range of sizes so it has to be walked
+	VkDeviceSize largestFreeSpan(const MemoryPool& pool)
+	{
+		if (pool.flBitmap == 0) return 0;
+
+		unsigned long fl, sl;
+		_BitScanReverse64(&fl, pool.flBitmap);
+		_BitScanReverse(&sl, pool.slBitmap[fl]);
+
+		VkDeviceSize largest = 0;
+		for (uint32_t idx = pool.freeHeads[fl][sl]; idx != NO_SPAN; idx = state.spans[idx].nextFree)
+		{
+			largest = state.spans[idx].size > largest ? state.spans[idx].size : largest;
+		}
+		return largest;
+	}
+
+	void getStats(uint32_t memoryType, MemoryTypeStats& outStats)
+	{
+		const MemoryPool& pool = state.memPools[memoryType];
+
+		outStats = state.typeStats[memoryType];
+		outStats.committed = pool.committed;
+		outStats.used = state.memTypeAllocSizes[memoryType];
+		outStats.largestFreeSpan = largestFreeSpan(pool);
+		outStats.blockCount = static_cast<uint32_t>(pool.blocks.size());
+	}
+
+	const char* getName()
+	{
+		return "tlsf";
+	}
 }
\ No newline at end of file
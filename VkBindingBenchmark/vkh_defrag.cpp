@@ -0,0 +1,123 @@
+#include "vkh_defrag.h"
+#include "config.h"
+#include "os_init.h"
+
+namespace vkh::defrag
+{
+	struct RetiredBuffer
+	{
+		VkBuffer buffer;
+		Allocation memory;
+		VkDevice device;
+		uint32_t framesLeft;
+	};
+
+	std::vector<MovableBuffer> movables;
+	std::vector<RetiredBuffer> retired;
+
+	uint32_t movedBuffers = 0;
+	VkDeviceSize movedBytes = 0;
+
+	void registerBuffer(const MovableBuffer& movable)
+	{
+		checkf(movable.usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT, "Movable buffers have to be usable as a copy source");
+		checkf(movable.usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT, "Movable buffers have to be usable as a copy destination");
+		movables.push_back(movable);
+	}
+
+	void unregisterBuffer(VkBuffer buffer)
+	{
+		for (uint32_t i = 0; i < movables.size(); ++i)
+		{
+			if (movables[i].buffer == buffer)
+			{
+				movables[i] = movables.back();
+				movables.pop_back();
+				return;
+			}
+		}
+	}
+
+	uint32_t countMovable(VkDeviceMemory memory)
+	{
+		uint32_t count = 0;
+		for (const MovableBuffer& m : movables)
+		{
+			count += m.memory.handle == memory;
+		}
+		return count;
+	}
+
+	uint32_t evacuate(VkDeviceMemory memory, double budgetMs, VkhContext& ctxt)
+	{
+		const double deadline = OS::getMilliseconds() + budgetMs;
+
+		VkhCommandBuffer scratch;
+		VkDeviceSize stepBytes = 0;
+
+		//every copy goes in one scratch command buffer, the owners are only told once it's finished
+		std::vector<uint32_t> moved;
+
+		for (uint32_t i = 0; i < movables.size(); ++i)
+		{
+			MovableBuffer& m = movables[i];
+			if (m.memory.handle != memory) continue;
+			if (OS::getMilliseconds() > deadline || stepBytes + m.size > DEFRAG_MAX_BYTES_PER_STEP) break;
+
+			if (moved.size() == 0)
+			{
+				scratch = beginScratchCommandBuffer(ECommandPoolType::Transfer, ctxt);
+			}
+
+			VkBuffer newBuffer;
+			Allocation newMemory;
+			createBuffer(newBuffer, newMemory, m.size, m.usage, m.properties, ctxt);
+			copyBuffer(m.buffer, newBuffer, m.size, 0, 0, scratch);
+
+			retired.push_back({ m.buffer, m.memory, ctxt.device, FRAMES_IN_FLIGHT });
+			m.buffer = newBuffer;
+			m.memory = newMemory;
+
+			moved.push_back(i);
+			stepBytes += m.size;
+		}
+
+		if (moved.size() == 0) return 0;
+
+		submitScratchCommandBuffer(scratch);
+
+		for (uint32_t i : moved)
+		{
+			movables[i].onMoved(movables[i].user, movables[i].buffer, movables[i].memory);
+		}
+
+		movedBuffers += static_cast<uint32_t>(moved.size());
+		movedBytes += stepBytes;
+		return static_cast<uint32_t>(moved.size());
+	}
+
+	void retireFrame()
+	{
+		for (uint32_t i = 0; i < retired.size();)
+		{
+			if (retired[i].framesLeft-- > 0)
+			{
+				++i;
+				continue;
+			}
+
+			vkDestroyBuffer(retired[i].device, retired[i].buffer, nullptr);
+			freeDeviceMemory(retired[i].memory);
+
+			retired[i] = retired.back();
+			retired.pop_back();
+		}
+	}
+
+	void getStats(uint32_t& outMovedBuffers, VkDeviceSize& outMovedBytes, uint32_t& outPendingFrees)
+	{
+		outMovedBuffers = movedBuffers;
+		outMovedBytes = movedBytes;
+		outPendingFrees = static_cast<uint32_t>(retired.size());
+	}
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include "vkh.h"
+
+//Buffers that the allocator is allowed to move. A move creates a new buffer wherever the allocator puts it, copies
+//the old contents over on the gpu and tells the owner through onMoved. The old buffer stays alive for
+//FRAMES_IN_FLIGHT more frames, in case frames already submitted still read from it, and is freed after that
+namespace vkh::defrag
+{
+	typedef void(*MovedCallback)(void* user, VkBuffer newBuffer, const Allocation& newMemory);
+
+	struct MovableBuffer
+	{
+		VkBuffer buffer;
+		Allocation memory;
+		VkDeviceSize size;
+
+		//what the buffer was created with, the replacement is created the same way. usage needs TRANSFER_SRC and TRANSFER_DST
+		VkBufferUsageFlags usage;
+		VkMemoryPropertyFlags properties;
+
+		MovedCallback onMoved;
+		void* user;
+	};
+
+	void registerBuffer(const MovableBuffer& movable);
+	void unregisterBuffer(VkBuffer buffer);
+
+	//number of registered buffers in a VkDeviceMemory block
+	uint32_t countMovable(VkDeviceMemory memory);
+
+	//moves registered buffers out of memory until budgetMs or DEFRAG_MAX_BYTES_PER_STEP runs out. The allocator has
+	//to make sure the replacements don't land in memory again. Returns the number of buffers moved
+	uint32_t evacuate(VkDeviceMemory memory, double budgetMs, VkhContext& ctxt);
+
+	//call once a frame, frees old buffers once no frame in flight can still be using them
+	void retireFrame();
+
+	void getStats(uint32_t& outMovedBuffers, VkDeviceSize& outMovedBytes, uint32_t& outPendingFrees);
+}
\ No newline at end of file
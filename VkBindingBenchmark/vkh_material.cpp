@@ -1,10 +1,18 @@
 #include "vkh_material.h"
 #include "config.h"
+#include "vkh_pipeline_cache.h"
+#include "os_init.h"
+#include "thread_pool.h"
+#include <string>
+#include <unordered_map>
 
 namespace vkh
 {
 	GlobalShaderDataStore globalData;
 
+	//modules stay alive for the life of the app so later materials and batches can share them
+	std::unordered_map<std::string, VkShaderModule> shaderModules;
+
 	void initGlobalShaderData(VkhContext& ctxt)
 	{
 		static bool isInitialized = false;
@@ -24,7 +32,7 @@ namespace vkh
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 				ctxt);
 
-			vkMapMemory(ctxt.device, globalData.mem.handle, globalData.mem.offset, globalData.size, 0, &globalData.mappedMemory);			
+			globalData.mappedMemory = globalData.mem.map;
 			
 			VkSamplerCreateInfo createInfo = vkh::samplerCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_MIPMAP_MODE_LINEAR, 0.0f);
 			VkResult res = vkCreateSampler(ctxt.device, &createInfo, 0, &globalData.sampler);
@@ -37,17 +45,34 @@ namespace vkh
 		}
 	}
 
-	void createBasicMaterial(const char* vShaderPath, const char* fShaderPath, VkhContext& ctxt, VkhMaterialCreateInfo& createInfo)
+	//not thread safe, batches load all their modules up front on the calling thread
+	VkShaderModule getShaderModule(const char* shaderPath, VkhContext& ctxt)
+	{
+		auto found = shaderModules.find(shaderPath);
+		if (found != shaderModules.end())
+		{
+			return found->second;
+		}
+
+		VkShaderModule module;
+		DataBuffer* shaderData = loadBinaryFile(shaderPath);
+		vkh::createShaderModule(module, shaderData->data, shaderData->size, ctxt);
+		freeDataBuffer(shaderData);
+
+		shaderModules[shaderPath] = module;
+		return module;
+	}
+
+	//safe to call from several threads at once, as long as each call has its own createInfo
+	void createGraphicsPipeline(VkShaderModule vShader, VkShaderModule fShader, VkhContext& ctxt, VkhMaterialCreateInfo& createInfo)
 	{
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 
 		shaderStages[0] = vkh::shaderPipelineStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT);
-		DataBuffer* vShaderData = loadBinaryFile(vShaderPath);
-		vkh::createShaderModule(shaderStages[0].module, vShaderData->data, vShaderData->size, ctxt);
+		shaderStages[0].module = vShader;
 
 		shaderStages[1] = vkh::shaderPipelineStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT);
-		DataBuffer* fShaderData = loadBinaryFile(fShaderPath);
-		vkh::createShaderModule(shaderStages[1].module, fShaderData->data, fShaderData->size, ctxt);
+		shaderStages[1].module = fShader;
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vkh::pipelineLayoutCreateInfo(createInfo.descSetLayouts.data(), createInfo.descSetLayouts.size());
 
@@ -109,10 +134,83 @@ namespace vkh
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 		pipelineInfo.basePipelineIndex = -1;
 
-		res = vkCreateGraphicsPipelines(ctxt.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, createInfo.outPipeline);
+		double createStart = OS::getMilliseconds();
+		res = vkCreateGraphicsPipelines(ctxt.device, ctxt.pipelineCache, 1, &pipelineInfo, nullptr, createInfo.outPipeline);
 		checkf(res == VK_SUCCESS, "Error creating graphics pipeline");
-		
-		freeDataBuffer(vShaderData);
-		freeDataBuffer(fShaderData);
+		addPipelineCreationTime(OS::getMilliseconds() - createStart);
+	}
+
+	void createBasicMaterial(const char* vShaderPath, const char* fShaderPath, VkhContext& ctxt, VkhMaterialCreateInfo& createInfo)
+	{
+		createGraphicsPipeline(getShaderModule(vShaderPath, ctxt), getShaderModule(fShaderPath, ctxt), ctxt, createInfo);
+	}
+
+	struct MaterialBatch
+	{
+		VkhMaterialBatchEntry* entries;
+		std::vector<VkShaderModule> vShaders;
+		std::vector<VkShaderModule> fShaders;
+		VkhContext* ctxt;
+	};
+
+	void createBatchEntry(uint32_t taskIdx, void* data)
+	{
+		MaterialBatch& batch = *(MaterialBatch*)data;
+		createGraphicsPipeline(batch.vShaders[taskIdx], batch.fShaders[taskIdx], *batch.ctxt, batch.entries[taskIdx].createInfo);
+	}
+
+	void createBasicMaterials(std::vector<VkhMaterialBatchEntry>& entries, VkhContext& ctxt)
+	{
+		double batchStart = OS::getMilliseconds();
+		size_t modulesBefore = shaderModules.size();
+
+		MaterialBatch batch;
+		batch.entries = entries.data();
+		batch.ctxt = &ctxt;
+
+		for (const VkhMaterialBatchEntry& entry : entries)
+		{
+			batch.vShaders.push_back(getShaderModule(entry.vShaderPath, ctxt));
+			batch.fShaders.push_back(getShaderModule(entry.fShaderPath, ctxt));
+		}
+
+		double modulesMs = OS::getMilliseconds() - batchStart;
+
+		thread_pool::parallelFor(static_cast<uint32_t>(entries.size()), createBatchEntry, &batch);
+
+		printf("Pipeline batch: %zu pipelines from %zu new shader modules on %u threads, %.2f ms loading modules, %.2f ms total\n",
+			entries.size(), shaderModules.size() - modulesBefore, thread_pool::getNumWorkers() + 1, modulesMs, OS::getMilliseconds() - batchStart);
+	}
+
+	//renderPass is ignored for compute materials
+	void createComputeMaterial(const char* cShaderPath, VkhContext& ctxt, VkhMaterialCreateInfo& createInfo)
+	{
+		VkPipelineShaderStageCreateInfo shaderStage = vkh::shaderPipelineStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT);
+		shaderStage.module = getShaderModule(cShaderPath, ctxt);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = vkh::pipelineLayoutCreateInfo(createInfo.descSetLayouts.data(), createInfo.descSetLayouts.size());
+
+		VkPushConstantRange pushConstantRange = {};
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = createInfo.pushConstantRange;
+		pushConstantRange.stageFlags = createInfo.pushConstantStages;
+
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+
+		VkResult res = vkCreatePipelineLayout(ctxt.device, &pipelineLayoutInfo, nullptr, createInfo.outPipelineLayout);
+		checkf(res == VK_SUCCESS, "Error creating compute pipeline layout");
+
+		VkComputePipelineCreateInfo pipelineInfo = {};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = shaderStage;
+		pipelineInfo.layout = *createInfo.outPipelineLayout;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		double createStart = OS::getMilliseconds();
+		res = vkCreateComputePipelines(ctxt.device, ctxt.pipelineCache, 1, &pipelineInfo, nullptr, createInfo.outPipeline);
+		checkf(res == VK_SUCCESS, "Error creating compute pipeline");
+		addPipelineCreationTime(OS::getMilliseconds() - createStart);
 	}
 }
\ No newline at end of file
@@ -44,6 +44,18 @@ namespace vkh
 		VkShaderStageFlagBits pushConstantStages;
 	};
 
+	struct VkhMaterialBatchEntry
+	{
+		const char* vShaderPath;
+		const char* fShaderPath;
+		VkhMaterialCreateInfo createInfo;
+	};
+
 	void initGlobalShaderData();
 	void createBasicMaterial(const char* vShaderPath, const char* fShaderPath, VkhContext& ctxt, VkhMaterialCreateInfo& createInfo);
+
+	//same as createBasicMaterial for every entry, but each shader is loaded once no matter how many entries use it,
+	//and the pipelines are created across the thread pool's workers, all through ctxt.pipelineCache
+	void createBasicMaterials(std::vector<VkhMaterialBatchEntry>& entries, VkhContext& ctxt);
+	void createComputeMaterial(const char* cShaderPath, VkhContext& ctxt, VkhMaterialCreateInfo& createInfo);
 }
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "vkh_memory_backend.h"
+#include "vkh_initializers.h"
+#include <unordered_map>
+
+namespace vkh::memory_backend
+{
+	bool mockEnabled = false;
+
+	MockStats mockStats;
+	uint64_t nextMockHandle = 1;
+	std::unordered_map<uint64_t, VkDeviceSize> mockSizes;
+
+	VkResult allocate(VkDevice device, VkDeviceSize size, uint32_t memoryType, VkDeviceMemory& outMemory)
+	{
+		if (!mockEnabled)
+		{
+			VkMemoryAllocateInfo info = vkh::memoryAllocateInfo(size, memoryType);
+			return vkAllocateMemory(device, &info, nullptr, &outMemory);
+		}
+
+		uint64_t handle = nextMockHandle++;
+		mockSizes[handle] = size;
+		outMemory = (VkDeviceMemory)(uintptr_t)handle;
+
+		mockStats.committed += size;
+		mockStats.peakCommitted = mockStats.committed > mockStats.peakCommitted ? mockStats.committed : mockStats.peakCommitted;
+		mockStats.liveAllocations++;
+		mockStats.peakAllocations = mockStats.liveAllocations > mockStats.peakAllocations ? mockStats.liveAllocations : mockStats.peakAllocations;
+		mockStats.totalAllocations++;
+
+		return VK_SUCCESS;
+	}
+
+	void free(VkDevice device, VkDeviceMemory memory)
+	{
+		if (!mockEnabled)
+		{
+			vkFreeMemory(device, memory, nullptr);
+			return;
+		}
+
+		auto found = mockSizes.find((uint64_t)(uintptr_t)memory);
+		checkf(found != mockSizes.end(), "Freeing memory the mock backend never handed out");
+
+		mockStats.committed -= found->second;
+		mockStats.liveAllocations--;
+		mockSizes.erase(found);
+	}
+
+	void* map(VkDevice device, VkDeviceMemory memory)
+	{
+		if (mockEnabled) return nullptr;
+
+		void* mapped;
+		VkResult res = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+		checkf(res == VK_SUCCESS, "Error mapping device memory");
+		return mapped;
+	}
+
+	void setMock(bool enabled)
+	{
+		mockEnabled = enabled;
+	}
+
+	void resetMockStats()
+	{
+		mockStats = {};
+		mockSizes.clear();
+	}
+
+	const MockStats& getMockStats()
+	{
+		return mockStats;
+	}
+}
\ No newline at end of file
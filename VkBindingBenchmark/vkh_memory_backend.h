@@ -0,0 +1,30 @@
+#pragma once
+#include "vkh.h"
+
+//Where the allocators in vkh_alloc.h get their VkDeviceMemory from. Normally a straight call into the driver,
+//with the mock enabled no driver calls are made at all: handles are fake and only the committed bytes are tracked,
+//so allocators can be measured and replayed against without a GPU doing anything
+namespace vkh::memory_backend
+{
+	struct MockStats
+	{
+		VkDeviceSize committed;
+		VkDeviceSize peakCommitted;
+		uint32_t liveAllocations;
+		uint32_t peakAllocations;
+		uint32_t totalAllocations;
+	};
+
+	VkResult allocate(VkDevice device, VkDeviceSize size, uint32_t memoryType, VkDeviceMemory& outMemory);
+	void free(VkDevice device, VkDeviceMemory memory);
+
+	//maps the whole of memory, which stays mapped until it's freed. The mock has nothing to map and returns nullptr
+	void* map(VkDevice device, VkDeviceMemory memory);
+
+	//only switch while nothing allocated from the other side is still alive
+	void setMock(bool enabled);
+
+	//forgets every mock allocation, call between replays
+	void resetMockStats();
+	const MockStats& getMockStats();
+}
\ No newline at end of file
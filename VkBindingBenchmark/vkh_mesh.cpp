@@ -1,9 +1,35 @@
 #include "vkh_mesh.h"
 
+#define ARENA_VERTEX_BLOCK_SIZE (64 * 1024 * 1024)
+#define ARENA_INDEX_BLOCK_SIZE (32 * 1024 * 1024)
+
+#define MESH_BUFFER_USAGE (VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)
+
 namespace vkh::Mesh
 {
 	VertexRenderData* _vkRenderData;
 
+	//a vertex and index buffer pair that meshes are bump allocated out of, a mesh never spans two blocks
+	struct ArenaBlock
+	{
+		VkBuffer vertexBuffer;
+		Allocation vertexMemory;
+		VkBuffer indexBuffer;
+		Allocation indexMemory;
+
+		VkDeviceSize vertexCapacity;
+		VkDeviceSize indexCapacity;
+		VkDeviceSize vertexUsed;
+		VkDeviceSize indexUsed;
+	};
+
+	std::vector<ArenaBlock> _arenaBlocks;
+
+	bool _compactIndices;
+	uint32_t _compactMeshCount;
+	uint32_t _meshCount;
+	VkDeviceSize _indexBytesSaved;
+
 	void setGlobalVertexLayout(std::vector<EMeshVertexAttribute> layout)
 	{
 		checkf(_vkRenderData == nullptr, "Attempting to set global vertex layout, but this has already been set");
@@ -40,11 +66,35 @@ namespace vkh::Mesh
 				_vkRenderData->attrDescriptions[i] = { i, 0, VK_FORMAT_R32G32B32A32_SFLOAT, curOffset };
 				curOffset += sizeof(glm::vec4);
 			}break;
+
+			//4 components so every attribute stays 4 byte aligned, the shader only reads xyz
+			case EMeshVertexAttribute::POSITION_UNORM16:
+			{
+				_vkRenderData->attrDescriptions[i] = { i, 0, VK_FORMAT_R16G16B16A16_UNORM, curOffset };
+				curOffset += sizeof(uint16_t) * 4;
+			}break;
+			case EMeshVertexAttribute::NORMAL_OCT16:
+			{
+				_vkRenderData->attrDescriptions[i] = { i, 0, VK_FORMAT_R16G16_SNORM, curOffset };
+				curOffset += sizeof(int16_t) * 2;
+			}break;
+			case EMeshVertexAttribute::NORMAL_OCT8:
+			{
+				_vkRenderData->attrDescriptions[i] = { i, 0, VK_FORMAT_R8G8_SNORM, curOffset };
+				curOffset += sizeof(int8_t) * 2;
+			}break;
+			case EMeshVertexAttribute::UV0_HALF:
+			case EMeshVertexAttribute::UV1_HALF:
+			{
+				_vkRenderData->attrDescriptions[i] = { i, 0, VK_FORMAT_R16G16_SFLOAT, curOffset };
+				curOffset += sizeof(uint16_t) * 2;
+			}break;
 			default: checkf(0, "Invalid vertex attribute specified"); break;
 			}
 		}
 
-		_vkRenderData->vertexSize = curOffset;
+		//8 bit normals can leave the stride at an odd size, keep vertices 4 byte aligned
+		_vkRenderData->vertexSize = (curOffset + 3) & ~3u;
 	}
 
 	const VertexRenderData* vertexRenderData()
@@ -54,19 +104,61 @@ namespace vkh::Mesh
 		return _vkRenderData;
 	}
 
-	uint32_t make(MeshAsset& outAsset, VkhContext& ctxt, float* vertices, uint32_t vertexCount, uint32_t* indices, uint32_t indexCount)
+	void setCompactIndices(bool enabled)
+	{
+		_compactIndices = enabled;
+	}
+
+	void getIndexStats(uint32_t& outCompactMeshes, uint32_t& outTotalMeshes, VkDeviceSize& outBytesSaved)
+	{
+		outCompactMeshes = _compactMeshCount;
+		outTotalMeshes = _meshCount;
+		outBytesSaved = _indexBytesSaved;
+	}
+
+	//picks the smallest index type that can address every vertex, returns the index data to upload,
+	//which is either indices or the narrowed copy in scratch
+	const void* packIndices(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, std::vector<uint16_t>& scratch, VkIndexType& outType, size_t& outSize)
+	{
+		_meshCount++;
+
+		if (!_compactIndices || vertexCount > 0xFFFF)
+		{
+			outType = VK_INDEX_TYPE_UINT32;
+			outSize = sizeof(uint32_t) * indexCount;
+			return indices;
+		}
+
+		scratch.resize(indexCount);
+		for (uint32_t i = 0; i < indexCount; ++i)
+		{
+			scratch[i] = static_cast<uint16_t>(indices[i]);
+		}
+
+		_compactMeshCount++;
+		_indexBytesSaved += (sizeof(uint32_t) - sizeof(uint16_t)) * indexCount;
+
+		outType = VK_INDEX_TYPE_UINT16;
+		outSize = sizeof(uint16_t) * indexCount;
+		return scratch.data();
+	}
+
+	uint32_t make(MeshAsset& outAsset, VkhContext& ctxt, const void* vertices, uint32_t vertexCount, uint32_t* indices, uint32_t indexCount)
 	{
 		size_t vBufferSize = vertexRenderData()->vertexSize * vertexCount;
-		size_t iBufferSize = sizeof(uint32_t) * indexCount;
 
 		MeshAsset& m = outAsset;
 		m.iCount = indexCount;
 		m.vCount = vertexCount;
 
+		std::vector<uint16_t> shortIndices;
+		size_t iBufferSize;
+		const void* indexData = packIndices(indices, indexCount, vertexCount, shortIndices, m.indexType, iBufferSize);
+
 		createBuffer(m.buffer,
 			m.bufferMemory,
 			vBufferSize + iBufferSize,
-			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			MESH_BUFFER_USAGE,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			ctxt
 		);
@@ -83,15 +175,8 @@ namespace vkh::Mesh
 			ctxt
 		);
 
-		void* data;
-		
-		vkMapMemory(ctxt.device, stagingMemory.handle, stagingMemory.offset, vBufferSize, 0, &data);
-		memcpy(data, vertices, (size_t)vBufferSize);
-		vkUnmapMemory(ctxt.device, stagingMemory.handle);
-		
-		vkMapMemory(ctxt.device, stagingMemory.handle, stagingMemory.offset + vBufferSize, iBufferSize, 0, &data);
-		memcpy(data, indices, (size_t)iBufferSize);
-		vkUnmapMemory(ctxt.device, stagingMemory.handle);
+		memcpy(stagingMemory.map, vertices, (size_t)vBufferSize);
+		memcpy((char*)stagingMemory.map + vBufferSize, indexData, (size_t)iBufferSize);
 
 		//copy to device local here
 		copyBuffer(stagingBuffer, m.buffer, vBufferSize+iBufferSize, 0, 0, nullptr, ctxt);
@@ -101,8 +186,125 @@ namespace vkh::Mesh
 		m.vOffset = 0;
 		m.iOffset = vBufferSize;
 
+		m.indexBuffer = m.buffer;
+		m.vertexOffset = 0;
+		m.firstIndex = 0;
+
+		return 0;
+
+	}
+
+	ArenaBlock& arenaBlockWithSpace(VkDeviceSize vBufferSize, VkDeviceSize iBufferSize, VkhContext& ctxt)
+	{
+		//only the newest block is filled, meshes load in draw list order so older blocks rarely have useful gaps
+		if (_arenaBlocks.size() > 0)
+		{
+			ArenaBlock& last = _arenaBlocks[_arenaBlocks.size() - 1];
+			if (last.vertexUsed + vBufferSize <= last.vertexCapacity && last.indexUsed + iBufferSize <= last.indexCapacity)
+			{
+				return last;
+			}
+		}
+
+		//meshes too big for a regular block get a block sized to fit them
+		ArenaBlock block = {};
+		block.vertexCapacity = vBufferSize > ARENA_VERTEX_BLOCK_SIZE ? vBufferSize : ARENA_VERTEX_BLOCK_SIZE;
+		block.indexCapacity = iBufferSize > ARENA_INDEX_BLOCK_SIZE ? iBufferSize : ARENA_INDEX_BLOCK_SIZE;
+
+		createBuffer(block.vertexBuffer,
+			block.vertexMemory,
+			block.vertexCapacity,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			ctxt
+		);
+
+		createBuffer(block.indexBuffer,
+			block.indexMemory,
+			block.indexCapacity,
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			ctxt
+		);
+
+		_arenaBlocks.push_back(block);
+		return _arenaBlocks[_arenaBlocks.size() - 1];
+	}
+
+	uint32_t makeInArena(MeshAsset& outAsset, VkhContext& ctxt, const void* vertices, uint32_t vertexCount, uint32_t* indices, uint32_t indexCount)
+	{
+		const uint32_t vertexSize = vertexRenderData()->vertexSize;
+		size_t vBufferSize = vertexSize * vertexCount;
+
+		MeshAsset& m = outAsset;
+		m.iCount = indexCount;
+		m.vCount = vertexCount;
+
+		std::vector<uint16_t> shortIndices;
+		size_t iBufferSize;
+		const void* indexData = packIndices(indices, indexCount, vertexCount, shortIndices, m.indexType, iBufferSize);
+		const VkDeviceSize indexSize = m.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		//blocks hold both index types, firstIndex counts in the mesh's own index size so 32 bit meshes need 4 byte alignment
+		ArenaBlock& block = arenaBlockWithSpace(vBufferSize, iBufferSize + sizeof(uint16_t), ctxt);
+		block.indexUsed = ((block.indexUsed + indexSize - 1) / indexSize) * indexSize;
+
+		m.buffer = block.vertexBuffer;
+		m.bufferMemory = block.vertexMemory;
+		m.indexBuffer = block.indexBuffer;
+		m.vOffset = 0;
+		m.iOffset = 0;
+		m.vertexOffset = static_cast<int32_t>(block.vertexUsed / vertexSize);
+		m.firstIndex = static_cast<uint32_t>(block.indexUsed / indexSize);
+
+		VkBuffer stagingBuffer;
+		Allocation stagingMemory;
+
+		createBuffer(stagingBuffer,
+			stagingMemory,
+			vBufferSize + iBufferSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			ctxt
+		);
+
+		memcpy(stagingMemory.map, vertices, vBufferSize);
+		memcpy((char*)stagingMemory.map + vBufferSize, indexData, iBufferSize);
+
+		VkhCommandBuffer scratch = beginScratchCommandBuffer(ECommandPoolType::Transfer, ctxt);
+		copyBuffer(stagingBuffer, block.vertexBuffer, vBufferSize, 0, static_cast<uint32_t>(block.vertexUsed), scratch);
+		copyBuffer(stagingBuffer, block.indexBuffer, iBufferSize, static_cast<uint32_t>(vBufferSize), static_cast<uint32_t>(block.indexUsed), scratch);
+		submitScratchCommandBuffer(scratch);
+
+		freeDeviceMemory(stagingMemory);
+		vkDestroyBuffer(ctxt.device, stagingBuffer, nullptr);
+
+		block.vertexUsed += vBufferSize;
+		block.indexUsed += iBufferSize;
+
 		return 0;
+	}
 
+	uint32_t getArenaBlockCount()
+	{
+		return static_cast<uint32_t>(_arenaBlocks.size());
+	}
+
+	void makeMovable(const MeshAsset& asset, defrag::MovedCallback onMoved, void* user)
+	{
+		checkf(asset.vertexOffset == 0 && asset.firstIndex == 0 && asset.buffer == asset.indexBuffer, "Arena meshes share their buffers and can't be moved");
+
+		//vertices then indices, see make
+		defrag::MovableBuffer movable;
+		movable.buffer = asset.buffer;
+		movable.memory = asset.bufferMemory;
+		movable.size = asset.iOffset + asset.iCount * (asset.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+		movable.usage = MESH_BUFFER_USAGE;
+		movable.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		movable.onMoved = onMoved;
+		movable.user = user;
+
+		defrag::registerBuffer(movable);
 	}
 
 	void quad(MeshAsset& outAsset, VkhContext& ctxt, float width, float height, float xOffset, float yOffset)
@@ -168,7 +370,7 @@ namespace vkh::Mesh
 					verts.push_back(0);
 
 				}break;
-				default: checkf(0, "Invalid vertex attribute specified"); break;
+				default: checkf(0, "quad only supports full float vertex attributes"); break;
 
 				}
 			}
@@ -1,5 +1,6 @@
 #pragma once
 #include "vkh.h"
+#include "vkh_defrag.h"
 
 #define GLM_FORCE_RADIANS
 //#define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -16,7 +17,15 @@ namespace vkh
 		NORMAL,
 		TANGENT,
 		BITANGENT,
-		COLOR
+		COLOR,
+
+		//quantized encodings, decoded by the vertex shader / fixed function fetch:
+		//position as 16 bit unorm relative to MeshAsset min / max, octahedral normals, half float uvs
+		POSITION_UNORM16,
+		NORMAL_OCT16,
+		NORMAL_OCT8,
+		UV0_HALF,
+		UV1_HALF
 	};
 
 	struct VertexRenderData
@@ -32,14 +41,28 @@ namespace vkh
 		VkBuffer buffer;
 		Allocation bufferMemory;
 
+		//the same buffer as above unless the mesh lives in the arena
+		VkBuffer indexBuffer;
+
+		//byte offsets to bind buffer / indexBuffer at
 		uint32_t vOffset;
 		uint32_t iOffset;
 
+		//draw parameters, only non zero for arena meshes, which all bind their block at offset 0
+		int32_t vertexOffset;
+		uint32_t firstIndex;
+
+		VkIndexType indexType;
+
 		uint32_t vCount;
 		uint32_t iCount;
 
 		glm::vec3 min;
 		glm::vec3 max;
+
+		//range in meshlet_builder::getMeshlets(), both 0 unless the mesh was split into meshlets
+		uint32_t firstMeshlet;
+		uint32_t meshletCount;
 	};
 }
 
@@ -49,6 +72,18 @@ namespace vkh::Mesh
 
 	const VertexRenderData* vertexRenderData();
 
-	uint32_t make(MeshAsset& outAsset, VkhContext& ctxt, float* vertices, uint32_t vertexCount, uint32_t* indices, uint32_t indexCount);
+	//when enabled, meshes made afterwards store 16 bit indices if all of their vertices can be addressed with them
+	void setCompactIndices(bool enabled);
+	void getIndexStats(uint32_t& outCompactMeshes, uint32_t& outTotalMeshes, VkDeviceSize& outBytesSaved);
+
+	uint32_t make(MeshAsset& outAsset, VkhContext& ctxt, const void* vertices, uint32_t vertexCount, uint32_t* indices, uint32_t indexCount);
+
+	//sub allocates the mesh out of a few large shared vertex and index buffers instead of giving it buffers of its own,
+	//meshes in the same arena block can all be drawn with one vertex / index bind
+	uint32_t makeInArena(MeshAsset& outAsset, VkhContext& ctxt, const void* vertices, uint32_t vertexCount, uint32_t* indices, uint32_t indexCount);
+	uint32_t getArenaBlockCount();
+
+	//lets the defragmenter move the mesh's buffer, onMoved has to update every copy of the MeshAsset. Arena meshes can't be moved
+	void makeMovable(const MeshAsset& asset, defrag::MovedCallback onMoved, void* user);
 	void quad(MeshAsset& outAsset, VkhContext& ctxt, float width = 2.0f, float height = 2.0f, float xOffset = 0.0f, float yOffset = 0.0f);
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "vkh_pipeline_cache.h"
+#include "config.h"
+#include "os_init.h"
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+
+#define PIPELINE_CACHE_PATH "..\\data\\_generated\\pipeline_cache.bin"
+#define PIPELINE_CACHE_TEMP_PATH "..\\data\\_generated\\pipeline_cache.bin.tmp"
+
+namespace vkh
+{
+	//matches the layout the spec requires at the start of vkGetPipelineCacheData's output
+	struct PipelineCacheHeader
+	{
+		uint32_t headerSize;
+		uint32_t headerVersion;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	struct PipelineCacheStats
+	{
+		double creationMs;
+		uint32_t numPipelines;
+		size_t loadedBytes;
+		const char* coldReason;
+	};
+
+	PipelineCacheStats cacheStats;
+	std::mutex statsLock;
+
+	//returns nullptr if the cache was written by a different driver or device, the driver would ignore it anyway
+	const char* validateHeader(const char* data, size_t size, const VkPhysicalDeviceProperties& props)
+	{
+		if (size < sizeof(PipelineCacheHeader)) return "file too small";
+
+		PipelineCacheHeader header;
+		memcpy(&header, data, sizeof(PipelineCacheHeader));
+
+		if (header.headerSize < sizeof(PipelineCacheHeader) || header.headerSize > size) return "bad header size";
+		if (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return "unknown header version";
+		if (header.vendorID != props.vendorID) return "different vendor";
+		if (header.deviceID != props.deviceID) return "different device";
+		if (memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0) return "different driver";
+
+		return nullptr;
+	}
+
+	void createPipelineCache(VkhContext& ctxt)
+	{
+		ctxt.pipelineCache = VK_NULL_HANDLE;
+		memset(&cacheStats, 0, sizeof(PipelineCacheStats));
+
+#if PIPELINE_CACHE
+		char* data = nullptr;
+		size_t size = 0;
+
+		//a missing file just means a cold start, unlike loadBinaryFile this can't be fatal
+		FILE* inFile = nullptr;
+		fopen_s(&inFile, PIPELINE_CACHE_PATH, "rb");
+		if (inFile)
+		{
+			fseek(inFile, 0, SEEK_END);
+			size = ftell(inFile);
+			rewind(inFile);
+
+			data = (char*)malloc(size);
+			checkf(data, "Allocation failed loading pipeline cache");
+			size = fread(data, 1, size, inFile);
+			fclose(inFile);
+
+			cacheStats.coldReason = validateHeader(data, size, ctxt.gpu.deviceProps);
+		}
+		else
+		{
+			cacheStats.coldReason = "no cache file";
+		}
+
+		VkPipelineCacheCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		createInfo.initialDataSize = cacheStats.coldReason ? 0 : size;
+		createInfo.pInitialData = cacheStats.coldReason ? nullptr : data;
+
+		VkResult res = vkCreatePipelineCache(ctxt.device, &createInfo, nullptr, &ctxt.pipelineCache);
+		checkf(res == VK_SUCCESS, "Error creating pipeline cache");
+
+		cacheStats.loadedBytes = createInfo.initialDataSize;
+		free(data);
+#else
+		cacheStats.coldReason = "PIPELINE_CACHE disabled";
+#endif
+	}
+
+	void savePipelineCache(VkhContext& ctxt)
+	{
+		if (ctxt.pipelineCache == VK_NULL_HANDLE) return;
+
+		size_t size = 0;
+		VkResult res = vkGetPipelineCacheData(ctxt.device, ctxt.pipelineCache, &size, nullptr);
+		checkf(res == VK_SUCCESS, "Error getting pipeline cache size");
+
+		char* data = (char*)malloc(size);
+		checkf(data, "Allocation failed saving pipeline cache");
+		res = vkGetPipelineCacheData(ctxt.device, ctxt.pipelineCache, &size, data);
+		checkf(res == VK_SUCCESS, "Error getting pipeline cache data");
+
+		FILE* outFile = nullptr;
+		fopen_s(&outFile, PIPELINE_CACHE_TEMP_PATH, "wb");
+		if (!outFile)
+		{
+			printf("Pipeline cache: couldn't open %s for writing, cache not saved\n", PIPELINE_CACHE_TEMP_PATH);
+			free(data);
+			return;
+		}
+
+		bool wroteAll = fwrite(data, 1, size, outFile) == size;
+		wroteAll &= fflush(outFile) == 0;
+		fclose(outFile);
+		free(data);
+
+		//the old cache is only replaced once the new one is completely on disk
+		if (!wroteAll || !MoveFileExA(PIPELINE_CACHE_TEMP_PATH, PIPELINE_CACHE_PATH, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		{
+			printf("Pipeline cache: failed to write %s, cache not saved\n", PIPELINE_CACHE_PATH);
+			remove(PIPELINE_CACHE_TEMP_PATH);
+			return;
+		}
+
+		printf("Pipeline cache: saved %zu bytes\n", size);
+	}
+
+	void addPipelineCreationTime(double ms)
+	{
+		std::lock_guard<std::mutex> lock(statsLock);
+		cacheStats.creationMs += ms;
+		cacheStats.numPipelines++;
+	}
+
+	void logPipelineCacheStats()
+	{
+		if (cacheStats.coldReason)
+		{
+			printf("Pipeline creation: %u pipelines in %.2f ms, cold cache (%s)\n", cacheStats.numPipelines, cacheStats.creationMs, cacheStats.coldReason);
+		}
+		else
+		{
+			printf("Pipeline creation: %u pipelines in %.2f ms, warm cache (%zu bytes loaded)\n", cacheStats.numPipelines, cacheStats.creationMs, cacheStats.loadedBytes);
+		}
+	}
+}
\ No newline at end of file
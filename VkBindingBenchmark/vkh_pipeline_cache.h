@@ -0,0 +1,19 @@
+#pragma once
+#include "vkh.h"
+
+//One VkPipelineCache shared by every pipeline the app creates. It's seeded from disk when the context is created
+//and written back at shutdown, so only the first launch of a configuration pays for full pipeline compilation
+namespace vkh
+{
+	//creates ctxt.pipelineCache, from the file on disk if its header matches this driver and device.
+	//ctxt.pipelineCache stays VK_NULL_HANDLE without PIPELINE_CACHE
+	void createPipelineCache(VkhContext& ctxt);
+
+	//writes to a temp file and swaps it in, a crash mid write never leaves a truncated cache behind
+	void savePipelineCache(VkhContext& ctxt);
+
+	//wall time spent in vkCreate*Pipelines, reported by logPipelineCacheStats along with whether the cache was warm.
+	//pipelines created in parallel each add their own time, so the total can exceed the time startup took
+	void addPipelineCreationTime(double ms);
+	void logPipelineCacheStats();
+}
\ No newline at end of file
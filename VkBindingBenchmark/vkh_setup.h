@@ -2,6 +2,9 @@
 #include "vkh_types.h"
 #include "vkh.h"
 #include "vkh_alloc.h"
+#include "vkh_pipeline_cache.h"
+#include "vkh_thread_cache.h"
+#include "config.h"
 namespace vkh
 {
 	struct VkhContextCreateInfo
@@ -14,6 +17,9 @@ namespace vkh
 
 	VkDebugReportCallbackEXT callback;
 
+	//set while creating the instance, the memory budget device extension can't be used without it
+	bool hasPhysicalDeviceProperties2 = false;
+
 	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 		VkDebugReportFlagsEXT flags,
 		VkDebugReportObjectTypeEXT objType,
@@ -133,6 +139,16 @@ namespace vkh
 
 		checkf(allExtensionsFound, "Failed to find all required vulkan extensions");
 
+		//optional, memory budgets are queried through vkGetPhysicalDeviceMemoryProperties2KHR
+		for (uint32_t i = 0; i < extensions.size(); ++i)
+		{
+			if (strcmp(extensions[i].extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+			{
+				requiredExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+				hasPhysicalDeviceProperties2 = true;
+			}
+		}
+
 		//create instance with all extensions
 
 		VkInstanceCreateInfo inst_info;
@@ -410,8 +426,39 @@ namespace vkh
 		std::vector<const char*> deviceExtensions;
 		deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
+		//optional, gpu driven draws fall back to plain indirect draws without it
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(physDevice.device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions;
+		availableExtensions.resize(extensionCount);
+		vkEnumerateDeviceExtensionProperties(physDevice.device, nullptr, &extensionCount, availableExtensions.data());
+
+		ctxt.gpu.supportsDrawIndirectCount = false;
+		for (uint32_t extIdx = 0; extIdx < availableExtensions.size(); ++extIdx)
+		{
+			if (strcmp(availableExtensions[extIdx].extensionName, VK_AMD_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0)
+			{
+				deviceExtensions.push_back(VK_AMD_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+				ctxt.gpu.supportsDrawIndirectCount = true;
+			}
+		}
+
+		//optional, memory stats fall back to reporting heap sizes without it
+		ctxt.gpu.supportsMemoryBudget = false;
+		for (uint32_t extIdx = 0; extIdx < availableExtensions.size() && hasPhysicalDeviceProperties2; ++extIdx)
+		{
+			if (strcmp(availableExtensions[extIdx].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+			{
+				deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+				ctxt.gpu.supportsMemoryBudget = true;
+			}
+		}
+
 		VkPhysicalDeviceFeatures deviceFeatures = {};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = physDevice.features.multiDrawIndirect;
+		deviceFeatures.drawIndirectFirstInstance = physDevice.features.drawIndirectFirstInstance;
 
 		VkDeviceCreateInfo createInfo = {};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -601,7 +648,16 @@ namespace vkh
 		createPhysicalDevice(ctxt);
 		createLogicalDevice(ctxt);
 
+#if TLSF_ALLOCATOR
+		vkh::allocators::tlsf::activate(&ctxt);
+#else
 		vkh::allocators::pool::activate(&ctxt);
+#endif
+
+#if THREAD_SAFE_ALLOCATOR
+		vkh::thread_cache::install(ctxt);
+#endif
+		createPipelineCache(ctxt);
 
 		createSwapchainForSurface(ctxt);
 		createCommandPool(ctxt.gfxCommandPool, ctxt.device, ctxt.gpu, ctxt.gpu.graphicsQueueFamilyIdx);
@@ -610,16 +666,6 @@ namespace vkh
 
 		createDescriptorPool(ctxt.descriptorPool, ctxt.device, info.types, info.typeCounts);
 
-		createVkSemaphore(ctxt.imageAvailableSemaphore, ctxt.device);
-		createVkSemaphore(ctxt.renderFinishedSemaphore, ctxt.device);
-
 		createQueryPool(ctxt.queryPool, ctxt.device, 10);
-
-		ctxt.frameFences.resize(ctxt.swapChain.imageViews.size());
-
-		for (uint32_t i = 0; i < ctxt.frameFences.size(); ++i)
-		{
-			createFence(ctxt.frameFences[i], ctxt.device);
-		}
 	}
 }
\ No newline at end of file
@@ -44,10 +44,7 @@ namespace vkh::Texture
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
 			ctxt);
 
-		void* data;
-		vkMapMemory(ctxt.device, stagingBufferMemory.handle, stagingBufferMemory.offset, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(ctxt.device, stagingBufferMemory.handle);
+		memcpy(stagingBufferMemory.map, pixels, static_cast<size_t>(imageSize));
 
 		stbi_image_free(pixels);
 
@@ -77,4 +74,4 @@ namespace vkh::Texture
 		vkDestroyBuffer(ctxt.device, stagingBuffer, nullptr);
 		vkh::freeDeviceMemory(stagingBufferMemory);
 	}
-}
+}
\ No newline at end of file
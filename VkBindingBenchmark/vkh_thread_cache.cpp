@@ -0,0 +1,396 @@
+#include "vkh_thread_cache.h"
+#include "vkh_memory_backend.h"
+#include "config.h"
+#include "os_init.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <random>
+
+#define CONTENTION_MAX_THREADS 16
+#define CONTENTION_LIVE_PER_THREAD 256
+#define CONTENTION_OPS_PER_THREAD 20000
+
+//mostly small vertex and index buffers, with the odd one too big for a chunk
+#define CONTENTION_MIN_SIZE (256.0)
+#define CONTENTION_MAX_SIZE (1024.0 * 1024.0)
+
+namespace vkh::thread_cache
+{
+	//slot 0 is never handed out, so a zeroed thread local means no chunk
+	const uint32_t NO_CHUNK = 0;
+
+	struct Chunk
+	{
+		Allocation memory;
+
+		//only touched by the thread the chunk belongs to
+		VkDeviceSize head;
+
+		//live allocations in the chunk, plus one while it's a thread's current chunk. Whoever drops it to 0 frees it
+		std::atomic<uint32_t> refs;
+	};
+
+	struct ThreadChunks
+	{
+		uint32_t generation;
+		uint32_t current[VK_MAX_MEMORY_TYPES];
+	};
+
+	struct CacheState
+	{
+		AllocatorInterface inner;
+		VkhContext* context;
+
+		//guards inner and unusedChunks
+		std::mutex lock;
+		std::vector<uint32_t> unusedChunks;
+
+		VkDeviceSize minAlignment;
+
+		//bumped every activate, a thread's chunks from an older generation are gone
+		std::atomic<uint32_t> generation;
+
+		char name[64];
+	};
+
+	Chunk chunks[THREAD_CACHE_MAX_CHUNKS];
+	CacheState state;
+	thread_local ThreadChunks threadChunks;
+
+	void cachedActivate(VkhContext* context);
+	void cachedAlloc(Allocation& outAlloc, AllocationCreateInfo createInfo);
+	void cachedFree(Allocation& allocation);
+	size_t lockedAllocatedSize(uint32_t memoryType);
+	uint32_t lockedNumAllocs();
+	void lockedGetStats(uint32_t memoryType, MemoryTypeStats& outStats);
+	const char* cachedGetName();
+
+	AllocatorInterface cachedImpl = { cachedActivate, cachedAlloc, cachedFree, lockedAllocatedSize, lockedNumAllocs, lockedGetStats, cachedGetName };
+
+	//every call goes straight to the wrapped allocator under the lock, what the benchmark measures chunks against
+	void lockedActivate(VkhContext* context);
+	void lockedAlloc(Allocation& outAlloc, AllocationCreateInfo createInfo);
+	void lockedFree(Allocation& allocation);
+	const char* lockedGetName();
+
+	AllocatorInterface lockedImpl = { lockedActivate, lockedAlloc, lockedFree, lockedAllocatedSize, lockedNumAllocs, lockedGetStats, lockedGetName };
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	//lock must be held
+	void reset(VkhContext* context)
+	{
+		state.context = context;
+
+		state.unusedChunks.clear();
+		for (uint32_t i = THREAD_CACHE_MAX_CHUNKS - 1; i > NO_CHUNK; --i)
+		{
+			state.unusedChunks.push_back(i);
+		}
+
+		//neighbours in a chunk mustn't share a page between a buffer and an image, or a non coherent atom
+		const VkPhysicalDeviceLimits& limits = context->gpu.deviceProps.limits;
+		state.minAlignment = 16;
+		state.minAlignment = limits.bufferImageGranularity > state.minAlignment ? limits.bufferImageGranularity : state.minAlignment;
+		state.minAlignment = limits.nonCoherentAtomSize > state.minAlignment ? limits.nonCoherentAtomSize : state.minAlignment;
+
+		state.generation++;
+	}
+
+	void install(VkhContext& ctxt)
+	{
+		checkf(ctxt.allocator.numAllocs() == 0, "The thread cache has to be installed before anything is allocated");
+
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		state.inner = ctxt.allocator;
+		reset(&ctxt);
+
+		ctxt.allocator = cachedImpl;
+	}
+
+	void cachedActivate(VkhContext* context)
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		state.inner.activate(context);
+		reset(context);
+
+		context->allocator = cachedImpl;
+	}
+
+	//the new chunk starts with the calling thread's reference
+	uint32_t acquireChunk(uint32_t memoryType, VkMemoryPropertyFlags usage)
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		checkf(state.unusedChunks.size() > 0, "Out of thread cache chunks, raise THREAD_CACHE_MAX_CHUNKS");
+
+		uint32_t idx = state.unusedChunks.back();
+		state.unusedChunks.pop_back();
+
+		AllocationCreateInfo createInfo = { usage, memoryType, THREAD_CACHE_CHUNK_SIZE, state.minAlignment };
+		state.inner.alloc(chunks[idx].memory, createInfo);
+		chunks[idx].head = 0;
+		chunks[idx].refs.store(1);
+
+		return idx;
+	}
+
+	void releaseChunk(uint32_t idx)
+	{
+		if (chunks[idx].refs.fetch_sub(1) != 1) return;
+
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		state.inner.free(chunks[idx].memory);
+		state.unusedChunks.push_back(idx);
+	}
+
+	void cachedAlloc(Allocation& outAlloc, AllocationCreateInfo createInfo)
+	{
+		if (createInfo.size > THREAD_CACHE_MAX_ALLOC_SIZE)
+		{
+			lockedAlloc(outAlloc, createInfo);
+			return;
+		}
+
+		ThreadChunks& local = threadChunks;
+		uint32_t generation = state.generation.load();
+		if (local.generation != generation)
+		{
+			memset(local.current, 0, sizeof(local.current));
+			local.generation = generation;
+		}
+
+		uint32_t memoryType = createInfo.memoryTypeIndex;
+		VkDeviceSize alignment = createInfo.alignment > state.minAlignment ? createInfo.alignment : state.minAlignment;
+		uint32_t idx = local.current[memoryType];
+
+		//offsets are aligned within the VkDeviceMemory, not the chunk, the chunk itself might only be minAlignment aligned
+		VkDeviceSize offset = 0;
+		if (idx != NO_CHUNK)
+		{
+			Chunk& chunk = chunks[idx];
+
+			//only this thread's reference is left, nothing in the chunk is alive any more
+			if (chunk.refs.load() == 1) chunk.head = 0;
+
+			offset = alignUp(chunk.memory.offset + chunk.head, alignment) - chunk.memory.offset;
+			if (offset + createInfo.size > THREAD_CACHE_CHUNK_SIZE)
+			{
+				local.current[memoryType] = NO_CHUNK;
+				releaseChunk(idx);
+				idx = NO_CHUNK;
+			}
+		}
+
+		if (idx == NO_CHUNK)
+		{
+			idx = acquireChunk(memoryType, createInfo.usage);
+			local.current[memoryType] = idx;
+			offset = alignUp(chunks[idx].memory.offset, alignment) - chunks[idx].memory.offset;
+		}
+
+		Chunk& chunk = chunks[idx];
+		chunk.head = offset + createInfo.size;
+		chunk.refs.fetch_add(1);
+
+		outAlloc.handle = chunk.memory.handle;
+		outAlloc.type = memoryType;
+		outAlloc.id = idx;
+		outAlloc.size = createInfo.size;
+		outAlloc.offset = chunk.memory.offset + offset;
+		outAlloc.context = state.context;
+		outAlloc.map = chunk.memory.map ? (char*)chunk.memory.map + offset : nullptr;
+	}
+
+	//the size an allocation was made with says where it came from
+	void cachedFree(Allocation& allocation)
+	{
+		if (allocation.size > THREAD_CACHE_MAX_ALLOC_SIZE)
+		{
+			lockedFree(allocation);
+			return;
+		}
+
+		releaseChunk(allocation.id);
+	}
+
+	void releaseThreadChunks()
+	{
+		ThreadChunks& local = threadChunks;
+		if (local.generation == state.generation.load())
+		{
+			for (uint32_t t = 0; t < VK_MAX_MEMORY_TYPES; ++t)
+			{
+				if (local.current[t] != NO_CHUNK) releaseChunk(local.current[t]);
+			}
+		}
+		memset(local.current, 0, sizeof(local.current));
+	}
+
+	void lockedActivate(VkhContext* context)
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		state.inner.activate(context);
+		reset(context);
+
+		context->allocator = lockedImpl;
+	}
+
+	void lockedAlloc(Allocation& outAlloc, AllocationCreateInfo createInfo)
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		state.inner.alloc(outAlloc, createInfo);
+	}
+
+	void lockedFree(Allocation& allocation)
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		state.inner.free(allocation);
+	}
+
+	size_t lockedAllocatedSize(uint32_t memoryType)
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		return state.inner.allocatedSize(memoryType);
+	}
+
+	uint32_t lockedNumAllocs()
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		return state.inner.numAllocs();
+	}
+
+	void lockedGetStats(uint32_t memoryType, MemoryTypeStats& outStats)
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		state.inner.getStats(memoryType, outStats);
+	}
+
+	//the benchmark swaps the wrapped allocator out, so the name is built on every call
+	const char* cachedGetName()
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		snprintf(state.name, sizeof(state.name), "%s, thread cached", state.inner.getName());
+		return state.name;
+	}
+
+	const char* lockedGetName()
+	{
+		std::lock_guard<std::mutex> heldLock(state.lock);
+		snprintf(state.name, sizeof(state.name), "%s, locked", state.inner.getName());
+		return state.name;
+	}
+
+	//keeps CONTENTION_LIVE_PER_THREAD allocations alive, replacing a random one every step. Half of them staging
+	//memory, half device local, like a loader uploading as it goes
+	void contentionThread(uint32_t threadIdx, const uint32_t* memoryTypes, const VkMemoryPropertyFlags* usages, const std::atomic<bool>* go, VkhContext* ctxt)
+	{
+		std::mt19937 rng(8675309 + threadIdx);
+		std::uniform_real_distribution<double> logSize(log(CONTENTION_MIN_SIZE), log(CONTENTION_MAX_SIZE));
+
+		std::vector<Allocation> live(CONTENTION_LIVE_PER_THREAD);
+
+		auto allocate = [&](Allocation& outAlloc)
+		{
+			uint32_t kind = rng() % 2;
+			VkDeviceSize size = (static_cast<VkDeviceSize>(exp(logSize(rng))) + 255) & ~255ull;
+			AllocationCreateInfo createInfo = { usages[kind], memoryTypes[kind], size, 256 };
+			ctxt->allocator.alloc(outAlloc, createInfo);
+		};
+
+		while (!go->load()) {}
+
+		for (Allocation& allocation : live)
+		{
+			allocate(allocation);
+		}
+
+		for (uint32_t i = 0; i < CONTENTION_OPS_PER_THREAD; ++i)
+		{
+			Allocation& victim = live[rng() % CONTENTION_LIVE_PER_THREAD];
+			ctxt->allocator.free(victim);
+			allocate(victim);
+		}
+
+		for (Allocation& allocation : live)
+		{
+			ctxt->allocator.free(allocation);
+		}
+
+		releaseThreadChunks();
+	}
+
+	//returns millions of allocs and frees per second, across all threads
+	double runContention(const AllocatorInterface& wrapper, uint32_t numThreads, const uint32_t* memoryTypes, const VkMemoryPropertyFlags* usages, VkhContext& ctxt)
+	{
+		memory_backend::resetMockStats();
+		wrapper.activate(&ctxt);
+
+		std::atomic<bool> go(false);
+		std::vector<std::thread> threads;
+		for (uint32_t i = 0; i < numThreads; ++i)
+		{
+			threads.push_back(std::thread(contentionThread, i, memoryTypes, usages, &go, &ctxt));
+		}
+
+		double start = OS::getMilliseconds();
+		go.store(true);
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		double elapsedMs = OS::getMilliseconds() - start;
+
+		//numAllocs counts blocks for the sub allocators, the stats count what's actually still allocated
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+			MemoryTypeStats stats;
+			ctxt.allocator.getStats(memoryTypes[i], stats);
+			checkf(stats.allocationCount == 0, "Contention benchmark leaked allocations");
+		}
+
+		double ops = 2.0 * (CONTENTION_LIVE_PER_THREAD + CONTENTION_OPS_PER_THREAD) * numThreads;
+		return ops / (elapsedMs * 1000.0);
+	}
+
+	void runContentionBenchmark(const AllocatorInterface* allocators, const char** names, uint32_t count, VkhContext& ctxt)
+	{
+		checkf(ctxt.allocator.numAllocs() == 0, "The contention benchmark has to run before anything is allocated");
+
+		const AllocatorInterface active = ctxt.allocator;
+		const AllocatorInterface activeInner = state.inner;
+
+		const VkMemoryPropertyFlags usages[2] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT };
+		const uint32_t memoryTypes[2] = { getMemoryType(ctxt.gpu.device, 0xFFFFFFFF, usages[0]), getMemoryType(ctxt.gpu.device, 0xFFFFFFFF, usages[1]) };
+
+		memory_backend::setMock(true);
+
+		printf("Allocator contention benchmark (%u allocations alive and %u replaced per thread, Mops/s)\n", CONTENTION_LIVE_PER_THREAD, CONTENTION_OPS_PER_THREAD);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			printf(" %s:\n", names[i]);
+
+			for (uint32_t numThreads = 1; numThreads <= CONTENTION_MAX_THREADS; numThreads *= 2)
+			{
+				state.inner = allocators[i];
+				double locked = runContention(lockedImpl, numThreads, memoryTypes, usages, ctxt);
+				double cached = runContention(cachedImpl, numThreads, memoryTypes, usages, ctxt);
+
+				printf("  %2u threads: single lock %.2f, thread cache %.2f (%.1fx)\n", numThreads, locked, cached, cached / locked);
+			}
+		}
+
+		memory_backend::resetMockStats();
+		memory_backend::setMock(false);
+
+		state.inner = activeInner;
+		active.activate(&ctxt);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+#include "vkh.h"
+
+//Makes ctxt.allocator safe to call from any thread. Each thread carves chunks out of the wrapped allocator, one per
+//memory type, and bump allocates small requests from them without taking a lock. Only getting a new chunk, giving
+//an empty one back and allocations bigger than THREAD_CACHE_MAX_ALLOC_SIZE go to the wrapped allocator, under one
+//lock. Space in a chunk is reused once everything in it has been freed, which suits uploads' allocate, copy, free
+namespace vkh::thread_cache
+{
+	//wraps ctxt.allocator, which can't have anything allocated yet. The wrapped allocator's stats count a chunk as one allocation
+	void install(VkhContext& ctxt);
+
+	//gives the calling thread's chunks back. Threads that allocated should call this before exiting, otherwise
+	//their chunks are only reclaimed once the allocator is activated again
+	void releaseThreadChunks();
+
+	//allocates and frees from 1 to 16 threads at once against each allocator on the mock memory backend, once with
+	//every call behind a single lock and once with per thread chunks, and prints the throughput of each. Allocators'
+	//state is reset by activating them, so this has to run before anything is allocated. ctxt's allocator is
+	//activated again afterwards
+	void runContentionBenchmark(const AllocatorInterface* allocators, const char** names, uint32_t count, VkhContext& ctxt);
+}
\ No newline at end of file
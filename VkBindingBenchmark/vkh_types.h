@@ -5,6 +5,20 @@
 #include <vulkan/vk_sdk_platform.h>
 #include <vector>
 
+//VK_EXT_memory_budget is newer than the vulkan headers in external/, so its struct is declared here
+#ifndef VK_EXT_memory_budget
+#define VK_EXT_memory_budget 1
+#define VK_EXT_MEMORY_BUDGET_EXTENSION_NAME "VK_EXT_memory_budget"
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT ((VkStructureType)1000237000)
+
+typedef struct VkPhysicalDeviceMemoryBudgetPropertiesEXT {
+	VkStructureType	sType;
+	void*			pNext;
+	VkDeviceSize	heapBudget[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize	heapUsage[VK_MAX_MEMORY_HEAPS];
+} VkPhysicalDeviceMemoryBudgetPropertiesEXT;
+#endif
+
 namespace vkh
 {
 	struct VkhContext;
@@ -24,6 +38,9 @@ namespace vkh
 		VkDeviceSize size;
 		VkDeviceSize offset;
 		VkhContext* context;
+
+		//persistently mapped pointer to offset for host visible memory, nullptr otherwise. Stays valid until freed
+		void* map;
 	};
 
 	struct AllocationCreateInfo
@@ -31,6 +48,24 @@ namespace vkh
 		VkMemoryPropertyFlags usage;
 		uint32_t memoryTypeIndex;
 		VkDeviceSize size;
+
+		//from VkMemoryRequirements, a power of two
+		VkDeviceSize alignment;
+	};
+
+	//live allocations by size, bucket 0 is everything under 1KB, bucket i is [2^(9 + i), 2^(10 + i)) bytes
+	//and the last bucket holds everything bigger
+	const uint32_t ALLOC_HISTOGRAM_BUCKETS = 16;
+
+	struct MemoryTypeStats
+	{
+		//bytes of VkDeviceMemory allocated from the driver, and how much of that is handed out
+		VkDeviceSize committed;
+		VkDeviceSize used;
+		VkDeviceSize largestFreeSpan;
+		uint32_t blockCount;
+		uint32_t allocationCount;
+		uint32_t sizeHistogram[ALLOC_HISTOGRAM_BUCKETS];
 	};
 
 	struct AllocatorInterface
@@ -40,6 +75,10 @@ namespace vkh
 		void(*free)(Allocation&);
 		size_t(*allocatedSize)(uint32_t);
 		uint32_t(*numAllocs)();
+		void(*getStats)(uint32_t, MemoryTypeStats&);
+
+		//wrappers include the name of the allocator they wrap
+		const char*(*getName)();
 	};
 
 	struct VkhDeviceQueues
@@ -69,6 +108,25 @@ namespace vkh
 		VkhContext* context;
 	};
 
+	//a ring of transfer queue command buffers, each one guarded by a fence so it can be recycled
+	//without idling the queue, and signalling a semaphore that the graphics submit waits on
+	struct VkhAsyncTransfer
+	{
+		std::vector<VkCommandBuffer>	commandBuffers;
+		std::vector<VkFence>			fences;
+		std::vector<VkSemaphore>		semaphores;
+		uint32_t						current;
+
+		//the destination buffers are shared by every frame, so each graphics submit signals one of these and
+		//the next transfer waits on it before overwriting what that frame read. null until the first graphics submit
+		std::vector<VkSemaphore>		graphicsDoneSemaphores;
+		VkSemaphore						graphicsWait;
+
+		//exclusive destination buffers, released to the graphics queue family after every copy
+		//and acquired at the start of the graphics command buffer. empty if the families are the same
+		std::vector<VkBufferMemoryBarrier>	ownershipBarriers;
+	};
+
 	struct VkhSwapChainSupportInfo
 	{
 		VkSurfaceCapabilitiesKHR capabilities;
@@ -87,6 +145,8 @@ namespace vkh
 		uint32_t							presentQueueFamilyIdx;
 		uint32_t							graphicsQueueFamilyIdx;
 		uint32_t							transferQueueFamilyIdx;
+		bool								supportsDrawIndirectCount;
+		bool								supportsMemoryBudget;
 	};
 
 	struct VkhSwapChain
@@ -111,9 +171,7 @@ namespace vkh
 		VkCommandPool			presentCommandPool;
 		VkQueryPool				queryPool;
 		VkDescriptorPool		descriptorPool;
-		VkSemaphore				imageAvailableSemaphore;
-		VkSemaphore				renderFinishedSemaphore;
-		std::vector<VkFence>	frameFences;
+		VkPipelineCache			pipelineCache;
 
 		AllocatorInterface		allocator;
 	};
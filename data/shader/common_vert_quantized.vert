@@ -0,0 +1,34 @@
+#version 450 core
+#extension GL_ARB_separate_shader_objects : enable
+
+//mvp already scales 16 bit unorm positions back out to the mesh bounds
+layout(push_constant) uniform transformData
+{
+	mat4 mvp;
+	mat4 it_mv;
+}global;
+
+layout(location=0) in vec3 vertex;
+layout(location=1) in vec2 uv;
+layout(location=2) in vec2 octNormal;
+
+layout(location=0) out vec2 fragUV;
+layout(location=1) out vec3 fragNorm;
+
+vec3 octDecode(vec2 oct)
+{
+	vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+	if (n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
+void main()
+{
+	gl_Position =  global.mvp * vec4(vertex, 1.0);
+
+	fragUV = uv;
+	fragNorm =  (global.it_mv * vec4(octDecode(octNormal), 0.0)).xyz; 
+}
\ No newline at end of file
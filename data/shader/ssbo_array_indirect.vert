@@ -0,0 +1,31 @@
+#version 450 core
+#extension GL_ARB_separate_shader_objects : enable
+
+struct tData
+{
+	mat4 mvp;
+	mat4 it_mv;
+};
+
+layout(binding=0,set=0)buffer TRANSFORM_DATA
+{
+	tData d[];
+}transform;
+
+layout(location=0) in vec3 vertex;
+layout(location=1) in vec2 uv;
+layout(location=2) in vec3 normal;
+
+layout(location=0) out vec2 fragUV;
+layout(location=1) out vec3 fragNorm;
+
+void main()
+{
+	//gpu culled draws carry the store slot in firstInstance
+	uint tform = gl_InstanceIndex;
+
+	gl_Position = transform.d[tform].mvp * vec4(vertex, 1.0);
+	fragNorm =  (transform.d[tform].it_mv * vec4(normal, 0.0)).xyz; 
+
+	fragUV = uv;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#version 450 core
+#extension GL_ARB_separate_shader_objects : enable
+
+struct tdata
+{
+	mat4 mvp;
+	mat4 it_mv;
+};
+
+layout(binding=0,set=0)buffer TRANSFORM_DATA
+{
+	tdata d[25000];
+}transform;
+
+//positions are 16 bit unorm relative to the mesh bounds
+layout(push_constant) uniform transformData
+{
+	vec4 posOffset;
+	vec4 posScale;
+	uint tform;
+}idx;
+
+layout(location=0) in vec3 vertex;
+layout(location=1) in vec2 uv;
+layout(location=2) in vec2 octNormal;
+
+layout(location=0) out vec2 fragUV;
+layout(location=1) out vec3 fragNorm;
+
+vec3 octDecode(vec2 oct)
+{
+	vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+	if (n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
+void main()
+{
+	vec3 pos = idx.posOffset.xyz + vertex * idx.posScale.xyz;
+
+	gl_Position = transform.d[idx.tform].mvp * vec4(pos, 1.0);
+	fragNorm =  (transform.d[idx.tform].it_mv * vec4(octDecode(octNormal), 0.0)).xyz; 
+
+	fragUV = uv;
+}
\ No newline at end of file